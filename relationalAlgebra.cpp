@@ -4,420 +4,6857 @@
 #include <set>
 #include <array>
 #include <map>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <type_traits>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <memory_resource>
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RELATIONAL_ALGEBRA_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
-enum Level {
-  EQUAL,
-  LESSTHAN,
-  GREATERTHAN
+/*
+ * When compiled with RELATIONAL_ALGEBRA_COUNT_ALLOCATIONS defined, every heap allocation of the program goes through
+ * these replacements of operator new / delete, so that the benchmarks and the operator profiles can report how many
+ * allocations (and bytes) an operator makes, and the peak heap memory it needs. Otherwise the counters stay 0 and
+ * allocations cost nothing extra.
+ * allocatedBytes counts the requested bytes; liveBytes and peakLiveBytes count the bytes malloc really reserved
+ * (its usable size), which is also known when the memory is freed. The counters are relaxed atomics, which can be
+ * updated from the thread pool, but each allocation still pays three atomic updates and a malloc_usable_size call.
+ */
+static atomic<size_t> allocationCount(0);
+static atomic<size_t> allocatedBytes(0);
+static atomic<size_t> liveBytes(0);
+static atomic<size_t> peakLiveBytes(0);
+
+#ifdef RELATIONAL_ALGEBRA_COUNT_ALLOCATIONS
+static const bool allocationsCounted = true;
+
+static size_t usableAllocationSize(void* memory) {
+#if defined(_WIN32)
+    return _msize(memory);
+#elif defined(__APPLE__)
+    return malloc_size(memory);
+#else
+    return malloc_usable_size(memory);
+#endif
+}
+
+/*
+ * The replacements of operator delete are not inlined: GCC would otherwise inline them into the code that got the
+ * memory from operator new, and warn that free is called on memory that did not come from malloc.
+ */
+#ifdef _MSC_VER
+#define NOINLINE_DEALLOCATION
+#else
+#define NOINLINE_DEALLOCATION __attribute__((noinline))
+#endif
+
+static void countAllocation(size_t size, size_t usableSize) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add(size, memory_order_relaxed);
+    size_t live = liveBytes.fetch_add(usableSize, memory_order_relaxed) + usableSize;
+    size_t peak = peakLiveBytes.load(memory_order_relaxed);
+    while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, memory_order_relaxed)) {}
+}
+
+void* operator new(size_t size) {
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == NULL)
+        throw bad_alloc();
+    countAllocation(size, usableAllocationSize(memory));
+    return memory;
+}
+
+NOINLINE_DEALLOCATION void operator delete(void* memory) noexcept {
+    if (memory == NULL)
+        return;
+    liveBytes.fetch_sub(usableAllocationSize(memory), memory_order_relaxed);
+    free(memory);
+}
+void operator delete(void* memory, size_t) noexcept {operator delete(memory);}
+
+// The pmr heap resource (used by the tuple sets outside of a queryArena) allocates with the aligned operator new
+void* operator new(size_t size, align_val_t alignment) {
+#if defined(_WIN32)
+    void* memory = _aligned_malloc(size > 0 ? size : 1, (size_t)alignment);
+    if (memory == NULL)
+        throw bad_alloc();
+    countAllocation(size, _aligned_msize(memory, (size_t)alignment, 0));
+#else
+    void* memory = NULL;
+    if (posix_memalign(&memory, (size_t)alignment < sizeof(void*) ? sizeof(void*) : (size_t)alignment, size > 0 ? size : 1) != 0)
+        throw bad_alloc();
+    countAllocation(size, usableAllocationSize(memory));
+#endif
+    return memory;
+}
+
+NOINLINE_DEALLOCATION void operator delete(void* memory, align_val_t alignment) noexcept {
+    if (memory == NULL)
+        return;
+#if defined(_WIN32)
+    liveBytes.fetch_sub(_aligned_msize(memory, (size_t)alignment, 0), memory_order_relaxed);
+    _aligned_free(memory);
+#else
+    // posix_memalign memory is freed with free, whatever its alignment
+    (void)alignment;
+    liveBytes.fetch_sub(usableAllocationSize(memory), memory_order_relaxed);
+    free(memory);
+#endif
+}
+void operator delete(void* memory, size_t, align_val_t alignment) noexcept {operator delete(memory, alignment);}
+#else
+static const bool allocationsCounted = false;
+#endif
+
+/*
+ * Operator profiling
+ *
+ * After enableProfiling(true), every call of loadFromFile, saveToFile, selection, projection, crossProduct and the
+ * joins (and their parallel and dynamicRelation versions, loadCompressedFile and compressedSelection) appends an
+ * operatorProfile to a global list. exportProfileJson writes the list as a JSON array, and exportChromeTrace as a
+ * Chrome trace (chrome://tracing or https://ui.perfetto.dev) where the operators called by another operator are
+ * nested under it.
+ * An operatorProfile holds the wall time of the call, the tuples of its inputs and output, the bytes it read and
+ * wrote (the bytes read from the file for loadFromFile and written to it for saveToFile, the bytes of the tuples of
+ * the input and output relations for the other operators), and the heap allocations and peak heap memory during the
+ * call.
+ *
+ *  Note:
+ *          When profiling is disabled, an operator only tests one flag on entry, so it can be left in the code
+ *          When compiled with RELATIONAL_ALGEBRA_NO_PROFILING defined, the operators do not even test the flag, and
+ *          enableProfiling(true) records nothing
+ *          The allocations and the peak memory are only counted when compiled with RELATIONAL_ALGEBRA_COUNT_ALLOCATIONS
+ *          (which makes every allocation slower, whether profiling is enabled or not), and otherwise are 0
+ *          The allocations and the peak memory are counted for the whole process, including the other threads
+ *          clearProfiles() empties the list, the timestamps count from the last enableProfiling(true)
+ */
+struct operatorProfile
+{
+    const char* operatorName;
+    int threadIndex;     // 0 for the first thread that ran a profiled operator, 1 for the next one, ...
+    int depth;           // the number of profiled operators this call is nested in
+    double startMicroseconds;
+    double durationMicroseconds;
+    long long inputTuples;
+    long long outputTuples;
+    long long bytesRead;
+    long long bytesWritten;
+    size_t allocations;
+    size_t allocatedBytes;
+    size_t peakBytes;    // the highest heap memory in use during the call, above what was in use before it
 };
 
-template <size_t arity>
-class relation
+#ifdef RELATIONAL_ALGEBRA_NO_PROFILING
+static const bool profilingCompiled = false;
+#else
+static const bool profilingCompiled = true;
+#endif
+static atomic<bool> profilingEnabled(false);
+static chrono::steady_clock::time_point profilingStart;
+static mutex profilesMutex;
+static vector<operatorProfile> profiles;
+static map<thread::id, int> profiledThreads;
+static thread_local int profileDepth = 0;
+
+static void enableProfiling(bool enabled) {
+    if (enabled && !profilingEnabled.load())
+        profilingStart = chrono::steady_clock::now();
+    profilingEnabled.store(enabled);
+}
+
+static void clearProfiles() {
+    lock_guard<mutex> lock(profilesMutex);
+    profiles.clear();
+}
+
+static vector<operatorProfile> getProfiles() {
+    lock_guard<mutex> lock(profilesMutex);
+    return profiles;
+}
+
+/*
+ * Profiles one operator call from its construction to its destruction, if profiling is enabled at construction.
+ *
+ *  For example:
+ *      profileScope profile("selection");
+ *      profile.addInput(inputRelation);
+ *      ...
+ *      return profile.finish(outputRelation.build());
+ */
+class profileScope
 {
 private:
-    int tupleCount;
-    set<array<int, arity>> dataBuffer;
+    bool active;
+    operatorProfile profile;
+    chrono::steady_clock::time_point start;
+    size_t allocationsBefore, allocatedBytesBefore, liveBytesBefore, outerPeakBytes;
 
 public:
-    relation() {tupleCount = 0;}
-    relation(const char *filename);
-    
-    void loadFromFile(const char *filename);
-    void saveToFile(const char *filename);
-    void printRelation();
-    
-    // These functions will be needed in the core RA operatior functions (projection, selection, cross-product and equi-join)
-    set<array<int, arity>> getDataBuffer() {return dataBuffer;}
-    void setDataBuffer(set<array<int, arity>> dataBuffer) {this->dataBuffer = dataBuffer;}
-    int getTupleCount() {return tupleCount;}
-    void setTupleCount(int tupleCount) {this->tupleCount = tupleCount;}
+    explicit profileScope(const char* operatorName) : active(profilingCompiled && profilingEnabled.load(memory_order_relaxed)) {
+        if (active)
+            begin(operatorName);
+    }
+    ~profileScope() {
+        if (active)
+            end();
+    }
+    profileScope(const profileScope&) = delete;
+    profileScope& operator=(const profileScope&) = delete;
+
+    // inputRelation is a relation<arity> or a dynamicRelation
+    template <class Relation>
+    void addInput(const Relation& inputRelation) {
+        if (active) {
+            profile.inputTuples += inputRelation.getTupleCount();
+            profile.bytesRead += tupleBytes(inputRelation);
+        }
+    }
+    void addInputTuples(long long tuples) {
+        if (active)
+            profile.inputTuples += tuples;
+    }
+    void addBytesRead(long long bytes) {
+        if (active)
+            profile.bytesRead += bytes;
+    }
+    void setOutput(long long tuples, long long bytes) {
+        if (active) {
+            profile.outputTuples = tuples;
+            profile.bytesWritten = bytes;
+        }
+    }
+    // Records outputRelation as the output of the operator and returns it
+    template <class Relation>
+    Relation finish(Relation outputRelation) {
+        if (active)
+            setOutput(outputRelation.getTupleCount(), tupleBytes(outputRelation));
+        return outputRelation;
+    }
+
+private:
+    void begin(const char* operatorName);
+    void end();
 };
 
+void profileScope::begin(const char* operatorName)
+{
+    profile = {operatorName, 0, profileDepth++, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    allocationsBefore = allocationCount.load(memory_order_relaxed);
+    allocatedBytesBefore = allocatedBytes.load(memory_order_relaxed);
+    liveBytesBefore = liveBytes.load(memory_order_relaxed);
+    // The peak of an enclosing profile or measurement is restored (and raised to this one's) at the end
+    outerPeakBytes = peakLiveBytes.exchange(liveBytesBefore);
+    start = chrono::steady_clock::now();
+}
+
+void profileScope::end()
+{
+    auto now = chrono::steady_clock::now();
+    --profileDepth;
+    size_t peak = peakLiveBytes.load();
+    profile.peakBytes = peak > liveBytesBefore ? peak - liveBytesBefore : 0;
+    profile.allocations = allocationCount.load(memory_order_relaxed) - allocationsBefore;
+    profile.allocatedBytes = allocatedBytes.load(memory_order_relaxed) - allocatedBytesBefore;
+    peak = peak > outerPeakBytes ? peak : outerPeakBytes;
+    size_t current = peakLiveBytes.load();
+    while (peak > current && !peakLiveBytes.compare_exchange_weak(current, peak)) {}
+    profile.startMicroseconds = chrono::duration<double, micro>(start - profilingStart).count();
+    profile.durationMicroseconds = chrono::duration<double, micro>(now - start).count();
+
+    lock_guard<mutex> lock(profilesMutex);
+    auto thread = profiledThreads.emplace(this_thread::get_id(), (int)profiledThreads.size()).first;
+    profile.threadIndex = thread->second;
+    profiles.push_back(profile);
+}
+
+static void writeProfileFields(FILE* pFile, const operatorProfile& profile) {
+    fprintf(pFile, "\"inputTuples\": %lld, \"outputTuples\": %lld, \"bytesRead\": %lld, \"bytesWritten\": %lld, "
+        "\"allocations\": %zu, \"allocatedBytes\": %zu, \"peakBytes\": %zu", profile.inputTuples, profile.outputTuples,
+        profile.bytesRead, profile.bytesWritten, profile.allocations, profile.allocatedBytes, profile.peakBytes);
+}
+
 /*
- * The data on file is comprised of "n" rows and "arity" columns 
- * The constructor loads data from a raw (binary) file.
- * The binary file is composed of n x arity integers.
- * So, if the size of the file is n bytes, then there are n/4 entries in the file.
- *
- * This function loads the data from the disk and populate the dataBuffer (which is a set of arrays). 
+ * Writes the profiles as a JSON array with one object per operator call, in the order the calls ended.
+ * The times are in microseconds.
  */
-template <size_t arity>
-void relation<arity>::loadFromFile(const char* filename)
-{
+static void exportProfileJson(const char* filename) {
     FILE* pFile;
-    long fileSize;
-    int* buffer;
-    size_t result;
+    errno_t err = fopen_s(&pFile, filename, "w");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    auto profiles = getProfiles();
+    fputs("[\n", pFile);
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        fprintf(pFile, "  {\"operator\": \"%s\", \"thread\": %d, \"depth\": %d, \"startMicroseconds\": %.3f, "
+            "\"durationMicroseconds\": %.3f, ", profiles[i].operatorName, profiles[i].threadIndex, profiles[i].depth,
+            profiles[i].startMicroseconds, profiles[i].durationMicroseconds);
+        writeProfileFields(pFile, profiles[i]);
+        fputs(i + 1 < profiles.size() ? "},\n" : "}\n", pFile);
+    }
+    fputs("]\n", pFile);
+    fclose(pFile);
+}
 
-    // ʹ fopen_s  fopen
-    errno_t err = fopen_s(&pFile, filename, "rb");
+// Writes the profiles in the Chrome trace event format, one complete ("X") event per operator call
+static void exportChromeTrace(const char* filename) {
+    FILE* pFile;
+    errno_t err = fopen_s(&pFile, filename, "w");
     if (err != 0 || pFile == NULL)
     {
         fputs("File error", stderr);
         exit(1);
     }
+    auto profiles = getProfiles();
+    fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n", pFile);
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        fprintf(pFile, "  {\"name\": \"%s\", \"cat\": \"operator\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+            "\"pid\": 0, \"tid\": %d, \"args\": {", profiles[i].operatorName, profiles[i].startMicroseconds,
+            profiles[i].durationMicroseconds, profiles[i].threadIndex);
+        writeProfileFields(pFile, profiles[i]);
+        fputs(i + 1 < profiles.size() ? "}},\n" : "}}\n", pFile);
+    }
+    fputs("]}\n", pFile);
+    fclose(pFile);
+}
 
-    // ȡļСֽΪλ
-    fseek(pFile, 0, SEEK_END);
-    fileSize = ftell(pFile);
-    rewind(pFile);
+/*
+ * EQUAL, LESSTHAN and GREATERTHAN compare one attribute with an operand.
+ * CONJUNCTION and DISJUNCTION combine several such predicates: all of them / at least one of them must hold.
+ */
+enum Level {
+  EQUAL,
+  LESSTHAN,
+  GREATERTHAN,
+  CONJUNCTION,
+  DISJUNCTION
+};
 
-    // ڴ԰ļ
-    buffer = (int*)malloc(fileSize);
-    if (buffer == NULL)
+// One comparison of a multi-predicate selection: tuple[attributeIndex] <operation> operand
+struct predicate
+{
+    int attributeIndex;
+    int operation;
+    int operand;
+};
+
+/*
+ * How a relation stores its tuples:
+ *  TREE_STORAGE - dataBuffer, a set with one red-black tree node (and one heap allocation) per tuple
+ *  FLAT_STORAGE - flatBuffer, one contiguous array of tuples that is kept sorted and deduplicated.
+ *                 It is filled with a single bulk sort + unique, has no per-tuple pointer overhead,
+ *                 and has the same layout as the binary files, so it is read and written with one fread/fwrite.
+ *  MAPPED_STORAGE - a read-only view of a binary file mapped into memory. Opening it costs no parsing, no copy and
+ *                 no per-tuple allocation, the pages are only read when an operator scans them. The tuples are
+ *                 exactly those of the file: they are neither sorted nor deduplicated, and the tuple count is the
+ *                 number of rows in the file.
+ *  BAG_STORAGE - flatBuffer as well, but the tuples are kept in insertion order and never deduplicated, so the
+ *                 relation is a multiset (bag). It skips the sort + unique of FLAT_STORAGE, and the operators keep
+ *                 every duplicate: a projection or join of a bag is a bag, with one output tuple per input tuple
+ *                 (pair), as needed by groupBy to count and sum them. The tuple count includes the duplicates.
+ *                 A cross product or join is a bag if either input is one (see joinOutputStorageMode).
+ * TREE_STORAGE and FLAT_STORAGE keep the tuples in the same (lexicographic) order, and every operator runs on all four.
+ * Converting a bag to TREE_STORAGE or FLAT_STORAGE deduplicates it.
+ */
+enum StorageMode {
+  TREE_STORAGE,
+  FLAT_STORAGE,
+  MAPPED_STORAGE,
+  BAG_STORAGE
+};
+
+/*
+ * A read-only memory mapping of a whole file, unmapped when the last relation using it is destroyed.
+ */
+class mappedFile
+{
+private:
+    const char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#endif
+
+public:
+    mappedFile(const char* filename);
+    ~mappedFile();
+    mappedFile(const mappedFile&) = delete;
+    mappedFile& operator=(const mappedFile&) = delete;
+
+    const char* getData() const {return data;}
+    size_t getSize() const {return size;}
+};
+
+#ifdef _WIN32
+mappedFile::mappedFile(const char* filename)
+{
+    data = NULL;
+    mappingHandle = NULL;
+    fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    LARGE_INTEGER fileSize;
+    if (fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &fileSize))
     {
-        cout << "Memory error" << endl;
-        fclose(pFile);  // ǵùرļ
+        fputs("File error", stderr);
         exit(1);
     }
+    size = (size_t)fileSize.QuadPart;
 
-    // ļݸƵ
-    result = fread(buffer, 1, fileSize, pFile);
-    if (result != fileSize)
+    // An empty file cannot be mapped, it is simply a view of 0 tuples
+    if (size == 0)
+        return;
+    mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mappingHandle != NULL)
+        data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL)
     {
-        cout << "File reading error" << endl;
-        free(buffer);   // ͷڴ
-        fclose(pFile);  // رļ
+        fputs("File mapping error", stderr);
         exit(1);
     }
+}
 
-    // رļ
-    fclose(pFile);
+mappedFile::~mappedFile()
+{
+    if (data != NULL)
+        UnmapViewOfFile(data);
+    if (mappingHandle != NULL)
+        CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+}
+#else
+mappedFile::mappedFile(const char* filename)
+{
+    data = NULL;
+    int fileDescriptor = open(filename, O_RDONLY);
+    struct stat fileStatus;
+    if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStatus) != 0)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    size = (size_t)fileStatus.st_size;
 
-    //  dataBuffer ݽṹϵ
-    for (int i = 0; i < fileSize / sizeof(int); i += arity)
+    // An empty file cannot be mapped, it is simply a view of 0 tuples
+    if (size > 0)
     {
-        std::array<int, arity> arr;
-        for (size_t j = 0; j < arity; ++j)
-            arr[j] = buffer[i + j];
-        dataBuffer.insert(arr);
+        void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            fputs("File mapping error", stderr);
+            exit(1);
+        }
+        // The operators scan the tuples from the first to the last one
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = (const char*)mapping;
+    }
+    // The mapping stays valid after the file is closed
+    close(fileDescriptor);
+}
+
+mappedFile::~mappedFile()
+{
+    if (data != NULL)
+        munmap((void*)data, size);
+}
+#endif
+
+/*
+ * Secondary indexes
+ *
+ * A relation can keep an index on any of its columns (relation::buildIndex). The index maps every value of the column
+ * to the positions of the tuples that have it, in the order visitTupleRange returns them, and relation::getTupleAt
+ * turns a position back into a tuple.
+ * selection uses an index for an EQUAL predicate (a SORTED_INDEX also for LESSTHAN and GREATERTHAN), and equiJoinHash
+ * uses an index on the first join column instead of building a hash table. saveToFile writes the indexes next to the
+ * data file ("<filename>.index<attributeIndex>") and loadFromFile reads them back, so they are not rebuilt on every load.
+ */
+enum IndexType {
+    HASH_INDEX,     // EQUAL lookups in O(1)
+    SORTED_INDEX    // EQUAL lookups in O(log n), and LESSTHAN / GREATERTHAN ranges
+};
+
+class columnIndex
+{
+private:
+    int indexType;
+    int attributeIndex;
+    // The distinct values of the column in increasing order. The positions of the tuples with value keys[i] are
+    // positions[offsets[i]] .. positions[offsets[i + 1] - 1], in increasing order
+    vector<int> keys;
+    vector<int> offsets;
+    vector<int> positions;
+    // HASH_INDEX only: value -> i in keys
+    unordered_map<int, int> keySlots;
+
+    columnIndex() {}
+    void buildKeySlots();
+
+public:
+    // columnValues[i] is the value of the indexed column in the tuple at position i
+    columnIndex(int indexType, int attributeIndex, const vector<int>& columnValues);
+    // Reads an index of tupleCount positions written by save, returns NULL if the file does not hold a valid index
+    static shared_ptr<const columnIndex> load(FILE* pFile, size_t tupleCount);
+    bool save(FILE* pFile) const;
+
+    int getIndexType() const {return indexType;}
+    int getAttributeIndex() const {return attributeIndex;}
+    size_t getTupleCount() const {return positions.size();}
+    /*
+     * Sets [first, last) to the positions of the tuples whose indexed column satisfies (value operation operand).
+     * For EQUAL the positions are in increasing order. Returns false if the index cannot answer the operation
+     * (LESSTHAN or GREATERTHAN on a HASH_INDEX).
+     */
+    bool lookup(int operation, int operand, const int*& first, const int*& last) const;
+};
+
+columnIndex::columnIndex(int indexType, int attributeIndex, const vector<int>& columnValues)
+{
+    this->indexType = indexType;
+    this->attributeIndex = attributeIndex;
+
+    // Sorting (value, position) pairs keeps the positions of every value in increasing order
+    vector<pair<int, int>> entries(columnValues.size());
+    for (size_t i = 0; i < columnValues.size(); ++i)
+        entries[i] = {columnValues[i], (int)i};
+    sort(entries.begin(), entries.end());
+
+    positions.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i == 0 || entries[i].first != entries[i - 1].first) {
+            keys.push_back(entries[i].first);
+            offsets.push_back(i);
+        }
+        positions.push_back(entries[i].second);
+    }
+    offsets.push_back(positions.size());
+    buildKeySlots();
+}
+
+void columnIndex::buildKeySlots()
+{
+    if (indexType != HASH_INDEX)
+        return;
+    keySlots.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        keySlots.emplace(keys[i], i);
+}
+
+bool columnIndex::lookup(int operation, int operand, const int*& first, const int*& last) const
+{
+    size_t keyBegin, keyEnd;
+    if (operation == EQUAL) {
+        if (indexType == HASH_INDEX) {
+            auto slot = keySlots.find(operand);
+            keyBegin = (slot == keySlots.end()) ? keys.size() : slot->second;
+            keyEnd = (slot == keySlots.end()) ? keys.size() : keyBegin + 1;
+        }
+        else {
+            keyBegin = lower_bound(keys.begin(), keys.end(), operand) - keys.begin();
+            keyEnd = (keyBegin < keys.size() && keys[keyBegin] == operand) ? keyBegin + 1 : keyBegin;
+        }
+    }
+    else if (indexType == SORTED_INDEX && operation == LESSTHAN) {
+        keyBegin = 0;
+        keyEnd = lower_bound(keys.begin(), keys.end(), operand) - keys.begin();
+    }
+    else if (indexType == SORTED_INDEX && operation == GREATERTHAN) {
+        keyBegin = upper_bound(keys.begin(), keys.end(), operand) - keys.begin();
+        keyEnd = keys.size();
+    }
+    else {
+        return false;
+    }
+    first = positions.data() + offsets[keyBegin];
+    last = positions.data() + offsets[keyEnd];
+    return true;
+}
+
+/*
+ * On disk an index is indexType, attributeIndex, the number of keys and the number of positions,
+ * followed by the keys, offsets and positions arrays, all 4-byte ints.
+ */
+bool columnIndex::save(FILE* pFile) const
+{
+    int header[4] = {indexType, attributeIndex, (int)keys.size(), (int)positions.size()};
+    return fwrite(header, sizeof(int), 4, pFile) == 4
+        && fwrite(keys.data(), sizeof(int), keys.size(), pFile) == keys.size()
+        && fwrite(offsets.data(), sizeof(int), offsets.size(), pFile) == offsets.size()
+        && fwrite(positions.data(), sizeof(int), positions.size(), pFile) == positions.size();
+}
+
+/*
+ * Every array is checked before the index is used: the keys must be increasing, every key must have at least one
+ * position (so the offsets are increasing and end at the number of positions), and every position must be one of the
+ * tupleCount tuples, so that a corrupt index file cannot make lookup or getTupleAt read out of bounds.
+ */
+shared_ptr<const columnIndex> columnIndex::load(FILE* pFile, size_t tupleCount)
+{
+    int header[4];
+    if (fread(header, sizeof(int), 4, pFile) != 4 || (header[0] != HASH_INDEX && header[0] != SORTED_INDEX)
+        || header[2] < 0 || header[3] < header[2] || (size_t)header[3] != tupleCount)
+        return NULL;
+
+    shared_ptr<columnIndex> index(new columnIndex());
+    index->indexType = header[0];
+    index->attributeIndex = header[1];
+    index->keys.resize(header[2]);
+    index->offsets.resize(header[2] + 1);
+    index->positions.resize(header[3]);
+    if (fread(index->keys.data(), sizeof(int), index->keys.size(), pFile) != index->keys.size()
+        || fread(index->offsets.data(), sizeof(int), index->offsets.size(), pFile) != index->offsets.size()
+        || fread(index->positions.data(), sizeof(int), index->positions.size(), pFile) != index->positions.size()
+        || index->offsets.front() != 0 || index->offsets.back() != header[3])
+        return NULL;
+    for (size_t i = 1; i < index->keys.size(); ++i)
+        if (index->keys[i - 1] >= index->keys[i])
+            return NULL;
+    for (size_t i = 1; i < index->offsets.size(); ++i)
+        if (index->offsets[i - 1] >= index->offsets[i])
+            return NULL;
+    for (int position : index->positions)
+        if (position < 0 || position >= header[3])
+            return NULL;
+    index->buildKeySlots();
+    return index;
+}
+
+/*
+ * The set of tuples of TREE_STORAGE. Its nodes (one per tuple) are allocated from the memory resource it is constructed
+ * with: the relations, relationBuilder and the join hash tables pass queryMemoryResource() unless they are given one.
+ */
+template <size_t arity>
+using tupleSet = pmr::set<array<int, arity>>;
+
+/*
+ * Per-query memory arenas
+ *
+ * While a queryArena is alive, it is the query memory resource of the thread that created it (queryMemoryResource()):
+ * the tuple sets of the relations (in TREE_STORAGE) and the hash tables of the joins constructed by that thread in
+ * its scope take their nodes from the arena instead of calling operator new once per tuple. Everything is released
+ * at once when the arena is destroyed. The process-wide pmr default resource is never changed.
+ *  MONOTONIC_ARENA - a monotonic_buffer_resource: an allocation is a pointer bump in a large chunk and freeing
+ *                    does nothing, best for a query that only builds its intermediate relations
+ *  POOL_ARENA - an unsynchronized_pool_resource: freed nodes are reused for the next allocations of the same size,
+ *               best for a query that also erases tuples or rebuilds relations many times (e.g. a fixpoint)
+ *
+ * For example:
+ *  relation<2> result;
+ *  {
+ *      queryArena arena(MONOTONIC_ARENA);
+ *      relation<4> joined = equiJoinHash(relation1, relation2, 1, joinColumns1, joinColumns2);
+ *      result = projection<4, 2>(joined, projectionColumns);
+ *  }
+ *
+ *  Note:
+ *          A relation constructed in the scope of an arena must not outlive it: assign it to a relation that was
+ *          declared before the arena (its tuples are then copied to the heap), or convert it to FLAT_STORAGE
+ *          The arena is not thread safe, so it is only used by the thread that created it: the worker threads of the
+ *          parallel operators (and any other thread) keep allocating from the heap
+ *          Arenas can be nested, the previous query memory resource is restored when an arena is destroyed
+ */
+enum ArenaType {
+  MONOTONIC_ARENA,
+  POOL_ARENA
+};
+
+// The innermost queryArena of this thread, or NULL
+static thread_local pmr::memory_resource* currentQueryResource = NULL;
+
+// The memory resource for the tuple sets and hash tables built by this thread: its queryArena, or the heap
+static pmr::memory_resource* queryMemoryResource() {
+    return currentQueryResource != NULL ? currentQueryResource : pmr::new_delete_resource();
+}
+
+class queryArena
+{
+private:
+    unique_ptr<pmr::memory_resource> resource;
+    pmr::memory_resource* previousResource;
+
+public:
+    explicit queryArena(int arenaType = MONOTONIC_ARENA, size_t initialBytes = 1 << 20);
+    ~queryArena();
+    queryArena(const queryArena&) = delete;
+    queryArena& operator=(const queryArena&) = delete;
+
+    pmr::memory_resource* getResource() const {return resource.get();}
+};
+
+queryArena::queryArena(int arenaType, size_t initialBytes)
+{
+    if (arenaType == POOL_ARENA)
+        resource.reset(new pmr::unsynchronized_pool_resource());
+    else
+        resource.reset(new pmr::monotonic_buffer_resource(initialBytes));
+    previousResource = currentQueryResource;
+    currentQueryResource = resource.get();
+}
+
+queryArena::~queryArena()
+{
+    currentQueryResource = previousResource;
+}
+
+template <size_t arity>
+class relation
+{
+private:
+    int tupleCount;
+    int storageMode;
+    // TREE_STORAGE only, empty in the other storage modes
+    tupleSet<arity> dataBuffer;
+    vector<array<int, arity>> flatBuffer;
+    // Copies of a mapped relation share the mapping
+    shared_ptr<mappedFile> mapping;
+    const array<int, arity>* mappedTuples;
+    size_t mappedTupleCount;
+
+    static_assert(sizeof(array<int, arity>) == arity * sizeof(int), "tuples must have the same layout as the binary files");
+
+    // indexes[i] is the index on column i, or NULL. Copies of a relation share its indexes
+    array<shared_ptr<const columnIndex>, arity> indexes;
+    // TREE_STORAGE with an index only: pointers to the tuples in set order, for getTupleAt. They are built together
+    // with the indexes (never by a const method), and rebuilt by a copy, whose set is another one
+    vector<const array<int, arity>*> treeTuples;
+
+    void mapFromFile(const char *filename);
+    void releaseMapping() {mapping.reset(); mappedTuples = NULL; mappedTupleCount = 0;}
+    // FLAT_STORAGE and BAG_STORAGE keep their tuples in flatBuffer
+    bool usesFlatBuffer() const {return storageMode == FLAT_STORAGE || storageMode == BAG_STORAGE;}
+    // Every change of the tuples (or of their order) invalidates the indexes
+    void dropIndexes() {for (auto& index : indexes) index.reset(); treeTuples.clear();}
+    void updateTreeTuples();
+    void saveIndexes(const char *filename) const;
+    void loadIndexes(const char *filename);
+
+public:
+    // The set of a TREE_STORAGE relation is allocated from resource (queryMemoryResource() at construction by default)
+    relation() : dataBuffer(queryMemoryResource()) {tupleCount = 0; storageMode = TREE_STORAGE; releaseMapping();}
+    explicit relation(int storageMode, pmr::memory_resource* resource = queryMemoryResource())
+        : dataBuffer(resource) {tupleCount = 0; this->storageMode = storageMode; releaseMapping();}
+    relation(const char *filename, int storageMode = TREE_STORAGE);
+    relation(const relation& other)
+        : tupleCount(other.tupleCount), storageMode(other.storageMode), dataBuffer(other.dataBuffer, queryMemoryResource()), flatBuffer(other.flatBuffer),
+          mapping(other.mapping), mappedTuples(other.mappedTuples), mappedTupleCount(other.mappedTupleCount), indexes(other.indexes) {
+        updateTreeTuples();
+    }
+    relation(relation&&) = default;
+    relation& operator=(const relation& other);
+    relation& operator=(relation&& other);
+    
+    void loadFromFile(const char *filename);
+    void saveToFile(const char *filename) const;
+    void printRelation() const;
+    
+    /*
+     * The tuples of a TREE_STORAGE relation as a set, without a copy. The other storage modes have no set (building
+     * one would copy the whole relation), so the operators scan the tuples of any storage mode with forEachTuple /
+     * visitTupleRange, and sameTuples compares two relations.
+     * setDataBuffer moves the set in when it is passed an rvalue (setDataBuffer(move(tuples))), and sets the tuple count.
+     * The set is a tupleSet (a pmr::set); code that needs a std::set copies it with copyDataBuffer(), and can also pass
+     * a std::set to setDataBuffer, which copies it into a tupleSet.
+     */
+    const tupleSet<arity>& getDataBuffer() const {
+        if (storageMode != TREE_STORAGE) {
+            cout << "getDataBuffer() is only available with TREE_STORAGE" << endl;
+            exit(1);
+        }
+        return dataBuffer;
+    }
+    set<array<int, arity>> copyDataBuffer() const {
+        const tupleSet<arity>& tuples = getDataBuffer();
+        return set<array<int, arity>>(tuples.begin(), tuples.end());
+    }
+    void setDataBuffer(tupleSet<arity> dataBuffer) {
+        this->dataBuffer = move(dataBuffer);
+        tupleCount = this->dataBuffer.size();
+        flatBuffer.clear();
+        releaseMapping();
+        dropIndexes();
+        storageMode = TREE_STORAGE;
+    }
+    // A template, so that a braced list of tuples still goes to the tupleSet version
+    template <class Allocator>
+    void setDataBuffer(const set<array<int, arity>, less<array<int, arity>>, Allocator>& dataBuffer) {
+        setDataBuffer(tupleSet<arity>(dataBuffer.begin(), dataBuffer.end(), queryMemoryResource()));
+    }
+    int getTupleCount() const {return tupleCount;}
+    void setTupleCount(int tupleCount) {this->tupleCount = tupleCount;}
+
+    // Flat storage: setFlatBuffer sorts and deduplicates the tuples, and updates the tuple count
+    const vector<array<int, arity>>& getFlatBuffer() const {return flatBuffer;}
+    void setFlatBuffer(vector<array<int, arity>> flatBuffer);
+    // Same as setFlatBuffer, for tuples that are already sorted and deduplicated
+    void setSortedFlatBuffer(vector<array<int, arity>> flatBuffer);
+    // Bag storage: keeps the tuples as they are (in this order, with their duplicates), and updates the tuple count
+    void setBagBuffer(vector<array<int, arity>> flatBuffer);
+    int getStorageMode() const {return storageMode;}
+    void setStorageMode(int storageMode);
+    // False for MAPPED_STORAGE, whose tuples are in file order, and BAG_STORAGE, whose tuples are in insertion order
+    bool isSorted() const {return storageMode != MAPPED_STORAGE && storageMode != BAG_STORAGE;}
+
+    /*
+     * Adds / removes one tuple, and returns false if the relation already has it / does not have it.
+     * It takes O(log n) in TREE_STORAGE, FLAT_STORAGE moves the tuples after it, and a MAPPED_STORAGE relation
+     * is first copied to TREE_STORAGE. Like every change of the tuples, it drops the indexes.
+     * A bag always appends the tuple (even if it already has it), and eraseTuple removes one of its copies.
+     */
+    bool insertTuple(const array<int, arity>& tuple);
+    bool eraseTuple(const array<int, arity>& tuple);
+
+    /*
+     * Builds a HASH_INDEX or SORTED_INDEX on column attributeIndex, replacing the index that column already has.
+     * The indexes are kept until the tuples change, and are also kept by setStorageMode between TREE_STORAGE and
+     * FLAT_STORAGE, since both keep the tuples in the same order.
+     */
+    void buildIndex(int attributeIndex, int indexType = HASH_INDEX);
+    void dropIndex(int attributeIndex);
+    // The index on column attributeIndex, or NULL
+    const columnIndex* getIndex(int attributeIndex) const {return indexes[attributeIndex].get();}
+    // The tuple at position (0 .. getTupleCount() - 1) in visitTupleRange order. A TREE_STORAGE relation only has
+    // positions while it has an index (they are the positions its indexes return)
+    const array<int, arity>& getTupleAt(int position) const;
+
+    /*
+     * Calls function(first, last) with the range of tuples of whichever buffer is in use
+     * (set iterators for TREE_STORAGE, pointers for FLAT_STORAGE, MAPPED_STORAGE and BAG_STORAGE).
+     * The tuples are in lexicographic order if isSorted().
+     */
+    template <class F>
+    void visitTupleRange(F function) const {
+        if (usesFlatBuffer())
+            function(flatBuffer.data(), flatBuffer.data() + flatBuffer.size());
+        else if (storageMode == MAPPED_STORAGE)
+            function(mappedTuples, mappedTuples + mappedTupleCount);
+        else
+            function(dataBuffer.begin(), dataBuffer.end());
+    }
+    // Calls function(tuple) for every tuple of the relation
+    template <class F>
+    void forEachTuple(F function) const {
+        visitTupleRange([&](auto first, auto last) {
+            for (; first != last; ++first)
+                function(*first);
+        });
+    }
+};
+
+template <size_t arity>
+void relation<arity>::setFlatBuffer(vector<array<int, arity>> flatBuffer)
+{
+    sort(flatBuffer.begin(), flatBuffer.end());
+    flatBuffer.erase(unique(flatBuffer.begin(), flatBuffer.end()), flatBuffer.end());
+    setSortedFlatBuffer(move(flatBuffer));
+}
+
+template <size_t arity>
+void relation<arity>::setSortedFlatBuffer(vector<array<int, arity>> flatBuffer)
+{
+    this->flatBuffer = move(flatBuffer);
+    dataBuffer.clear();
+    releaseMapping();
+    dropIndexes();
+    storageMode = FLAT_STORAGE;
+    tupleCount = this->flatBuffer.size();
+}
+
+template <size_t arity>
+void relation<arity>::setBagBuffer(vector<array<int, arity>> flatBuffer)
+{
+    setSortedFlatBuffer(move(flatBuffer));
+    storageMode = BAG_STORAGE;
+}
+
+template <size_t arity>
+bool relation<arity>::insertTuple(const array<int, arity>& tuple)
+{
+    if (storageMode == MAPPED_STORAGE)
+        setStorageMode(TREE_STORAGE);
+    if (storageMode == BAG_STORAGE) {
+        flatBuffer.push_back(tuple);
+    }
+    else if (storageMode == FLAT_STORAGE) {
+        auto position = lower_bound(flatBuffer.begin(), flatBuffer.end(), tuple);
+        if (position != flatBuffer.end() && *position == tuple)
+            return false;
+        flatBuffer.insert(position, tuple);
+    }
+    else if (!dataBuffer.insert(tuple).second) {
+        return false;
+    }
+    ++tupleCount;
+    dropIndexes();
+    return true;
+}
+
+template <size_t arity>
+bool relation<arity>::eraseTuple(const array<int, arity>& tuple)
+{
+    if (storageMode == MAPPED_STORAGE)
+        setStorageMode(TREE_STORAGE);
+    if (storageMode == BAG_STORAGE) {
+        auto position = find(flatBuffer.begin(), flatBuffer.end(), tuple);
+        if (position == flatBuffer.end())
+            return false;
+        flatBuffer.erase(position);
+    }
+    else if (storageMode == FLAT_STORAGE) {
+        auto position = lower_bound(flatBuffer.begin(), flatBuffer.end(), tuple);
+        if (position == flatBuffer.end() || *position != tuple)
+            return false;
+        flatBuffer.erase(position);
+    }
+    else if (dataBuffer.erase(tuple) == 0) {
+        return false;
+    }
+    --tupleCount;
+    dropIndexes();
+    return true;
+}
+
+/*
+ * Converts the relation to another storage mode.
+ * A mapped relation is copied into memory (sorted and deduplicated, except for BAG_STORAGE); a relation cannot be
+ * converted to MAPPED_STORAGE, it has to be saved and loaded again with MAPPED_STORAGE.
+ * A bag is sorted and deduplicated when it is converted to TREE_STORAGE or FLAT_STORAGE, and a set converted to
+ * BAG_STORAGE keeps its order (its indexes stay valid).
+ */
+template <size_t arity>
+void relation<arity>::setStorageMode(int storageMode)
+{
+    if (storageMode == this->storageMode)
+        return;
+    if (storageMode == MAPPED_STORAGE) {
+        cout << "Only a file can be loaded with MAPPED_STORAGE" << endl;
+        exit(1);
+    }
+    if (this->storageMode == MAPPED_STORAGE) {
+        if (storageMode == BAG_STORAGE) {
+            setBagBuffer(vector<array<int, arity>>(mappedTuples, mappedTuples + mappedTupleCount));
+        }
+        else if (storageMode == FLAT_STORAGE) {
+            setFlatBuffer(vector<array<int, arity>>(mappedTuples, mappedTuples + mappedTupleCount));
+        }
+        else {
+            dataBuffer = tupleSet<arity>(mappedTuples, mappedTuples + mappedTupleCount, dataBuffer.get_allocator());
+            tupleCount = dataBuffer.size();
+            releaseMapping();
+            dropIndexes();
+            this->storageMode = TREE_STORAGE;
+        }
+        return;
+    }
+    if (this->storageMode == BAG_STORAGE) {
+        if (storageMode == FLAT_STORAGE) {
+            setFlatBuffer(move(flatBuffer));
+        }
+        else {
+            setDataBuffer(tupleSet<arity>(flatBuffer.begin(), flatBuffer.end(), dataBuffer.get_allocator()));
+            flatBuffer.shrink_to_fit();
+        }
+        return;
+    }
+    // A sorted, deduplicated flat buffer is also a valid bag, so FLAT_STORAGE to BAG_STORAGE only changes the mode
+    if (this->storageMode == TREE_STORAGE) {
+        // The set is already sorted and deduplicated, so the tuples are simply copied in order
+        flatBuffer.assign(dataBuffer.begin(), dataBuffer.end());
+        dataBuffer.clear();
+    }
+    else if (storageMode == TREE_STORAGE) {
+        dataBuffer = tupleSet<arity>(flatBuffer.begin(), flatBuffer.end(), dataBuffer.get_allocator());
+        flatBuffer.clear();
+        flatBuffer.shrink_to_fit();
+    }
+    this->storageMode = storageMode;
+    updateTreeTuples();
+}
+
+/*
+ * Collects the output tuples of an operator in the storage mode of the output relation.
+ * Tree storage inserts every tuple into the set right away, flat storage appends them and sorts + deduplicates
+ * once in build(), and bag storage only appends them.
+ * An operator that inserts its tuples already sorted and deduplicated (e.g. a selection of a sorted relation)
+ * passes sortedInsertion, then the set is appended at its end and the flat buffer is not sorted again.
+ */
+template <size_t arity>
+class relationBuilder
+{
+private:
+    int storageMode;
+    bool sortedInsertion;
+    tupleSet<arity> dataBuffer;
+    vector<array<int, arity>> flatBuffer;
+
+public:
+    // The output of an operator on a mapped relation is kept in memory with FLAT_STORAGE. A TREE_STORAGE output is
+    // allocated from resource
+    relationBuilder(int storageMode, bool sortedInsertion = false, pmr::memory_resource* resource = queryMemoryResource())
+        : dataBuffer(resource) {
+        this->storageMode = (storageMode == MAPPED_STORAGE) ? FLAT_STORAGE : storageMode;
+        this->sortedInsertion = sortedInsertion;
+    }
+
+    void insert(const array<int, arity>& tuple) {
+        if (storageMode == FLAT_STORAGE || storageMode == BAG_STORAGE)
+            flatBuffer.push_back(tuple);
+        else if (sortedInsertion)
+            dataBuffer.insert(dataBuffer.end(), tuple);
+        else
+            dataBuffer.insert(tuple);
+    }
+
+    relation<arity> build() {
+        auto outputRelation = relation<arity>(TREE_STORAGE, dataBuffer.get_allocator().resource());
+        if (storageMode == BAG_STORAGE) {
+            outputRelation.setBagBuffer(move(flatBuffer));
+        }
+        else if (storageMode == FLAT_STORAGE) {
+            if (sortedInsertion)
+                outputRelation.setSortedFlatBuffer(move(flatBuffer));
+            else
+                outputRelation.setFlatBuffer(move(flatBuffer));
+        }
+        else {
+            // Also sets the tuple count for the output relation
+            outputRelation.setDataBuffer(move(dataBuffer));
+        }
+        return outputRelation;
+    }
+};
+
+/*
+ * The data on file is comprised of "n" rows and "arity" columns 
+ * The constructor loads data from a raw (binary) file.
+ * The binary file is composed of n x arity integers.
+ * So, if the size of the file is n bytes, then there are n/4 entries in the file.
+ *
+ * This function loads the data from the disk and populate the dataBuffer (which is a set of arrays). 
+ */
+template <size_t arity>
+void relation<arity>::loadFromFile(const char* filename)
+{
+    profileScope profile("loadFromFile");
+    dropIndexes();
+    if (storageMode == MAPPED_STORAGE)
+    {
+        // The mapped pages are only read by the operators that scan them
+        mapFromFile(filename);
+        loadIndexes(filename);
+        profile.setOutput(tupleCount, 0);
+        return;
+    }
+
+    FILE* pFile;
+    long fileSize;
+    int* buffer;
+    size_t result;
+
+    // ʹ fopen_s  fopen
+    errno_t err = fopen_s(&pFile, filename, "rb");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+
+    // ȡļСֽΪλ
+    fseek(pFile, 0, SEEK_END);
+    fileSize = ftell(pFile);
+    rewind(pFile);
+    profile.addBytesRead(fileSize);
+
+    if (storageMode == FLAT_STORAGE || storageMode == BAG_STORAGE)
+    {
+        // The file has the same layout as the flat buffer, so it is read straight into it and sorted + deduplicated once
+        // (a bag keeps the tuples of the file as they are)
+        vector<array<int, arity>> fileTuples(fileSize / sizeof(array<int, arity>));
+        result = fread(fileTuples.data(), sizeof(array<int, arity>), fileTuples.size(), pFile);
+        fclose(pFile);
+        if (result != fileTuples.size())
+        {
+            cout << "File reading error" << endl;
+            exit(1);
+        }
+        if (storageMode == BAG_STORAGE)
+            setBagBuffer(move(fileTuples));
+        else
+            setFlatBuffer(move(fileTuples));
+        loadIndexes(filename);
+        profile.setOutput(tupleCount, 0);
+        return;
+    }
+
+    // ڴ԰ļ
+    buffer = (int*)malloc(fileSize);
+    if (buffer == NULL)
+    {
+        cout << "Memory error" << endl;
+        fclose(pFile);  // ǵùرļ
+        exit(1);
+    }
+
+    // ļݸƵ
+    result = fread(buffer, 1, fileSize, pFile);
+    if (result != fileSize)
+    {
+        cout << "File reading error" << endl;
+        free(buffer);   // ͷڴ
+        fclose(pFile);  // رļ
+        exit(1);
+    }
+
+    // رļ
+    fclose(pFile);
+
+    //  dataBuffer ݽṹϵ
+    for (int i = 0; i < fileSize / sizeof(int); i += arity)
+    {
+        std::array<int, arity> arr;
+        for (size_t j = 0; j < arity; ++j)
+            arr[j] = buffer[i + j];
+        dataBuffer.insert(arr);
+    }
+
+    tupleCount = dataBuffer.size();
+    profile.setOutput(tupleCount, 0);
+
+    // ͷŻ
+    free(buffer);
+
+    loadIndexes(filename);
+}
+
+
+
+static string indexFileName(const char* filename, int attributeIndex) {
+    return string(filename) + ".index" + to_string(attributeIndex);
+}
+
+/*
+ * Removes the index files of a data file of the given arity. Every function that writes a raw data file calls it
+ * first, so that the indexes of the previous content of the file are not loaded with the new one.
+ */
+static void removeIndexFiles(const char* filename, int arity) {
+    for (int attributeIndex = 0; attributeIndex < arity; ++attributeIndex)
+        remove(indexFileName(filename, attributeIndex).c_str());
+}
+
+// Seeks to a 64-bit offset: fseek takes a long, which only has 32 bits on Windows, so files over 2 GB need _fseeki64
+static void seekFile(FILE* pFile, int64_t offset) {
+#ifdef _WIN32
+    int result = _fseeki64(pFile, offset, SEEK_SET);
+#else
+    int result = fseeko(pFile, (off_t)offset, SEEK_SET);
+#endif
+    if (result != 0)
+    {
+        cout << "File reading error" << endl;
+        exit(1);
+    }
+}
+
+/*
+ * The size, the modification time and a checksum of sampled blocks of a data file. saveIndexes stores them in the
+ * index files and loadIndexes only uses an index if they still match the data file, so an index is not used with other
+ * data, even if the data file was rewritten by a program that did not remove the index files. Only
+ * SIGNATURE_SAMPLE_BLOCKS blocks of SIGNATURE_BLOCK_BYTES bytes are read (files up to 64 KB are read whole), so
+ * checking the signature does not read a large data file again and a MAPPED_STORAGE relation still only maps it.
+ *
+ * Note: a rewrite that keeps the size and the modification time (to the second) and only changes bytes between the
+ * sampled blocks is not detected.
+ */
+struct dataFileSignature
+{
+    uint64_t fileBytes;
+    int64_t modificationTime;
+    uint64_t checksum;
+
+    bool operator==(const dataFileSignature& other) const
+    {
+        return fileBytes == other.fileBytes && modificationTime == other.modificationTime && checksum == other.checksum;
+    }
+};
+
+static const int SIGNATURE_SAMPLE_BLOCKS = 16;
+static const size_t SIGNATURE_BLOCK_BYTES = 4096;
+
+// Reads the size and modification time of the data file and checksums SIGNATURE_SAMPLE_BLOCKS evenly spaced blocks
+static dataFileSignature readDataFileSignature(const char* filename) {
+#ifdef _WIN32
+    struct _stat64 fileStatus;
+    int result = _stat64(filename, &fileStatus);
+#else
+    struct stat fileStatus;
+    int result = stat(filename, &fileStatus);
+#endif
+    FILE* pFile;
+    errno_t err = fopen_s(&pFile, filename, "rb");
+    if (result != 0 || err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    dataFileSignature signature = {(uint64_t)fileStatus.st_size, (int64_t)fileStatus.st_mtime, 0x9e3779b97f4a7c15ull};
+    vector<uint64_t> block(SIGNATURE_BLOCK_BYTES / sizeof(uint64_t));
+    for (int sample = 0; sample < SIGNATURE_SAMPLE_BLOCKS; ++sample) {
+        // The first block starts the file and the last one ends it; a short file is read once
+        uint64_t offset = 0;
+        if (signature.fileBytes > SIGNATURE_BLOCK_BYTES)
+            offset = (signature.fileBytes - SIGNATURE_BLOCK_BYTES) * sample / (SIGNATURE_SAMPLE_BLOCKS - 1);
+        seekFile(pFile, (int64_t)offset);
+        size_t readBytes = fread(block.data(), 1, SIGNATURE_BLOCK_BYTES, pFile);
+        // A short read ends with a partial word, which is padded with zeros
+        memset((char*)block.data() + readBytes, 0, SIGNATURE_BLOCK_BYTES - readBytes);
+        for (size_t i = 0; i < (readBytes + sizeof(uint64_t) - 1) / sizeof(uint64_t); ++i) {
+            signature.checksum ^= block[i] * 0x87c37b91114253d5ull;
+            signature.checksum = ((signature.checksum << 27) | (signature.checksum >> 37)) * 0x4cf5ad432745937full;
+        }
+        if (signature.fileBytes <= SIGNATURE_BLOCK_BYTES)
+            break;
+    }
+    fclose(pFile);
+    return signature;
+}
+
+template <size_t arity>
+void relation<arity>::saveToFile(const char* filename) const
+{
+    profileScope profile("saveToFile");
+    profile.addInputTuples(tupleCount);
+    profile.setOutput(tupleCount, tupleBytes(*this));
+    removeIndexFiles(filename, (int)arity);
+    FILE* pFile;
+
+    // ʹ fopen_s ļעһ FILE* ָ
+    errno_t err = fopen_s(&pFile, filename, "wb");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+
+    if (storageMode != TREE_STORAGE)
+    {
+        // The flat buffer and the mapped file already have the on-disk layout, so they are written with a single fwrite
+        if (usesFlatBuffer())
+            fwrite(flatBuffer.data(), sizeof(array<int, arity>), flatBuffer.size(), pFile);
+        else
+            fwrite(mappedTuples, sizeof(array<int, arity>), mappedTupleCount, pFile);
+        fclose(pFile);
+        saveIndexes(filename);
+        return;
+    }
+
+    //  dataBuffer ݽṹд뵽
+    for (const auto& tuple : dataBuffer)  // ʹԱⲻҪĿ
+    {
+        int temp[arity];
+        for (int i = 0; i < arity; i++)
+            temp[i] = tuple[i];
+        fwrite(temp, sizeof(int), arity, pFile);
+    }
+
+    // رļ
+    fclose(pFile);
+
+    saveIndexes(filename);
+}
+
+/*
+ * Writes every index to "<filename>.index<attributeIndex>" (saveToFile has removed the old index files). An index
+ * file starts with the arity, the tuple count, whether the data file was sorted and the dataFileSignature of the data
+ * file, which loadIndexes checks before using it.
+ */
+template <size_t arity>
+void relation<arity>::saveIndexes(const char* filename) const
+{
+    if (none_of(indexes.begin(), indexes.end(), [](const shared_ptr<const columnIndex>& index) {return index != NULL;}))
+        return;
+    dataFileSignature signature = readDataFileSignature(filename);
+    for (int attributeIndex = 0; attributeIndex < (int)arity; ++attributeIndex) {
+        string indexFile = indexFileName(filename, attributeIndex);
+        if (indexes[attributeIndex] == NULL)
+            continue;
+
+        FILE* pFile;
+        errno_t err = fopen_s(&pFile, indexFile.c_str(), "wb");
+        if (err != 0 || pFile == NULL)
+        {
+            fputs("File error", stderr);
+            exit(1);
+        }
+        int header[3] = {(int)arity, tupleCount, isSorted() ? 1 : 0};
+        bool written = fwrite(header, sizeof(int), 3, pFile) == 3 && fwrite(&signature, sizeof(signature), 1, pFile) == 1
+            && indexes[attributeIndex]->save(pFile);
+        fclose(pFile);
+        if (!written)
+        {
+            fputs("File error", stderr);
+            exit(1);
+        }
+    }
+}
+
+/*
+ * Reads the index files written by saveIndexes, if there are any. The positions of an index are only valid if the
+ * tuples are in the same order as when it was saved: a file loaded with TREE_STORAGE or FLAT_STORAGE is sorted and
+ * deduplicated, so its indexes are only used if the file was written sorted (MAPPED_STORAGE and BAG_STORAGE keep the
+ * file order). An index is also only used if the data file still has the dataFileSignature it had when the index was
+ * saved (which only reads a few blocks of the data file, only if it has index files). Invalid index files are ignored.
+ */
+template <size_t arity>
+void relation<arity>::loadIndexes(const char* filename)
+{
+    bool hasSignature = false;
+    dataFileSignature signature;
+    for (int attributeIndex = 0; attributeIndex < (int)arity; ++attributeIndex) {
+        FILE* pFile;
+        errno_t err = fopen_s(&pFile, indexFileName(filename, attributeIndex).c_str(), "rb");
+        if (err != 0 || pFile == NULL)
+            continue;
+
+        int header[3];
+        dataFileSignature savedSignature;
+        if (fread(header, sizeof(int), 3, pFile) == 3 && header[0] == (int)arity && header[1] == tupleCount
+            && (header[2] == 1 || storageMode == MAPPED_STORAGE || storageMode == BAG_STORAGE)
+            && fread(&savedSignature, sizeof(savedSignature), 1, pFile) == 1) {
+            if (!hasSignature) {
+                signature = readDataFileSignature(filename);
+                hasSignature = true;
+            }
+            auto index = (savedSignature == signature) ? columnIndex::load(pFile, tupleCount) : NULL;
+            if (index != NULL && index->getAttributeIndex() == attributeIndex)
+                indexes[attributeIndex] = index;
+        }
+        fclose(pFile);
+    }
+    updateTreeTuples();
+}
+
+template <size_t arity>
+void relation<arity>::dropIndex(int attributeIndex)
+{
+    if (attributeIndex < 0 || attributeIndex >= (int)arity) {
+        cout << "You are trying to drop an index on an invalid attribute" << endl;
+        exit(1);
+    }
+    indexes[attributeIndex].reset();
+}
+
+template <size_t arity>
+void relation<arity>::buildIndex(int attributeIndex, int indexType)
+{
+    if (attributeIndex < 0 || attributeIndex >= (int)arity) {
+        cout << "You are trying to build an index on an invalid attribute" << endl;
+        exit(1);
+    }
+    vector<int> columnValues;
+    columnValues.reserve(tupleCount);
+    forEachTuple([&](const array<int, arity>& tuple) {columnValues.push_back(tuple[attributeIndex]);});
+    indexes[attributeIndex] = make_shared<const columnIndex>(indexType, attributeIndex, columnValues);
+    if (treeTuples.empty())
+        updateTreeTuples();
+}
+
+template <size_t arity>
+const array<int, arity>& relation<arity>::getTupleAt(int position) const
+{
+    if (usesFlatBuffer())
+        return flatBuffer[position];
+    if (storageMode == MAPPED_STORAGE)
+        return mappedTuples[position];
+    if (treeTuples.empty()) {
+        cout << "A TREE_STORAGE relation needs an index for getTupleAt" << endl;
+        exit(1);
+    }
+    return *treeTuples[position];
+}
+
+template <size_t arity>
+void relation<arity>::updateTreeTuples()
+{
+    treeTuples.clear();
+    if (storageMode != TREE_STORAGE || none_of(indexes.begin(), indexes.end(), [](const shared_ptr<const columnIndex>& index) {return index != NULL;}))
+        return;
+    treeTuples.reserve(dataBuffer.size());
+    for (const auto& tuple : dataBuffer)
+        treeTuples.push_back(&tuple);
+}
+
+// The copy keeps its own allocator (e.g. the heap for a relation declared before a queryArena), like the set it holds
+template <size_t arity>
+relation<arity>& relation<arity>::operator=(const relation& other)
+{
+    if (this == &other)
+        return *this;
+    tupleCount = other.tupleCount;
+    storageMode = other.storageMode;
+    dataBuffer = other.dataBuffer;
+    flatBuffer = other.flatBuffer;
+    mapping = other.mapping;
+    mappedTuples = other.mappedTuples;
+    mappedTupleCount = other.mappedTupleCount;
+    indexes = other.indexes;
+    updateTreeTuples();
+    return *this;
+}
+
+// Moving a set into one with another memory resource moves its tuples one by one, so the pointers are rebuilt
+template <size_t arity>
+relation<arity>& relation<arity>::operator=(relation&& other)
+{
+    tupleCount = other.tupleCount;
+    storageMode = other.storageMode;
+    dataBuffer = move(other.dataBuffer);
+    flatBuffer = move(other.flatBuffer);
+    mapping = move(other.mapping);
+    mappedTuples = other.mappedTuples;
+    mappedTupleCount = other.mappedTupleCount;
+    indexes = move(other.indexes);
+    if (dataBuffer.get_allocator() == other.dataBuffer.get_allocator())
+        treeTuples = move(other.treeTuples);
+    else
+        updateTreeTuples();
+    other.treeTuples.clear();
+    return *this;
+}
+
+/*
+ * Maps the binary file into memory and uses it as the tuples of the relation, without reading or copying anything.
+ * Any trailing bytes that do not make up a whole tuple are ignored.
+ */
+template <size_t arity>
+void relation<arity>::mapFromFile(const char* filename)
+{
+    dataBuffer.clear();
+    flatBuffer.clear();
+    dropIndexes();
+    mapping = make_shared<mappedFile>(filename);
+    mappedTuples = (const array<int, arity>*)mapping->getData();
+    mappedTupleCount = mapping->getSize() / sizeof(array<int, arity>);
+    tupleCount = mappedTupleCount;
+    storageMode = MAPPED_STORAGE;
+}
+
+template <size_t arity>
+relation<arity>::relation(const char *filename, int storageMode)
+    : dataBuffer(queryMemoryResource())
+{
+    tupleCount = 0;
+    this->storageMode = storageMode;
+    releaseMapping();
+    loadFromFile(filename);
+}
+
+template <size_t arity>
+void relation<arity>::printRelation() const
+{
+    if (storageMode != TREE_STORAGE)
+    {
+        cout << "Number of tuples in the relation: " << tupleCount << endl;
+        forEachTuple([](const array<int, arity>& tuple)
+        {
+            for (int j=0; j < arity; j++)
+            {
+                if (j < arity-1)
+                    cout << tuple[j] << " ";
+                else
+                    cout << tuple[j] << endl;
+            }
+        });
+        return;
+    }
+
+    cout << "Number of tuples in the relation: " << dataBuffer.size() << endl;
+
+    auto it = dataBuffer.begin();
+    for (int i = 0; i < dataBuffer.size(); i++)
+    {
+        std::array<int, arity> arr = *it;
+        for (int j=0; j < arity; j++)
+        {
+            if (j < arity-1)
+                cout << arr[j] << " ";
+            else
+                cout << arr[j] << endl;
+        }
+        it++;
+    }
+}
+
+// The bytes of the tuples of a relation, as counted by the operator profiles
+template <size_t arity>
+static long long tupleBytes(const relation<arity>& inputRelation) {
+    return (long long)inputRelation.getTupleCount() * sizeof(array<int, arity>);
+}
+
+/*
+ * True if the two relations have the same distinct tuples, whatever their storage modes. Sorted relations are
+ * compared in place; a MAPPED_STORAGE or BAG_STORAGE relation is first copied, sorted and deduplicated.
+ */
+template <size_t arity>
+static bool sameTuples(const relation<arity>& relation1, const relation<arity>& relation2) {
+    if (relation1.isSorted() && relation2.isSorted()) {
+        bool same = false;
+        relation1.visitTupleRange([&](auto first1, auto last1) {
+            relation2.visitTupleRange([&](auto first2, auto last2) {same = equal(first1, last1, first2, last2);});
+        });
+        return same;
+    }
+    auto distinctTuples = [](const relation<arity>& inputRelation) {
+        vector<array<int, arity>> tuples;
+        tuples.reserve(inputRelation.getTupleCount());
+        inputRelation.forEachTuple([&](const array<int, arity>& tuple) {tuples.push_back(tuple);});
+        if (!inputRelation.isSorted()) {
+            sort(tuples.begin(), tuples.end());
+            tuples.erase(unique(tuples.begin(), tuples.end()), tuples.end());
+        }
+        return tuples;
+    };
+    return distinctTuples(relation1) == distinctTuples(relation2);
+}
+
+
+
+static bool selectionCondition(int value, int operation, int operand) {
+    switch (operation) {
+    case EQUAL:
+        return value == operand;
+    case LESSTHAN:
+        return value < operand;
+    case GREATERTHAN:
+        return value > operand;
+    }
+    return false;
+}
+
+static bool predicatesHold(const int* tuple, const predicate* predicates, int predicateCount, int combination) {
+    for (int i = 0; i < predicateCount; ++i) {
+        bool condition = selectionCondition(tuple[predicates[i].attributeIndex], predicates[i].operation, predicates[i].operand);
+        if (combination == CONJUNCTION && !condition)
+            return false;
+        if (combination == DISJUNCTION && condition)
+            return true;
+    }
+    return combination == CONJUNCTION;
+}
+
+// Exits with an error unless every predicate is a valid comparison on a column, combined with CONJUNCTION or DISJUNCTION
+template<size_t arity>
+static void checkSelectionPredicates(const predicate* predicates, int predicateCount, int combination) {
+    for (int i = 0; i < predicateCount; ++i) {
+        if (predicates[i].attributeIndex < 0 || predicates[i].attributeIndex >= (int)arity) {
+            cout << "You are trying to do a selection on an invalid attribute" << endl;
+            exit(1);
+        }
+        if (predicates[i].operation != EQUAL && predicates[i].operation != LESSTHAN && predicates[i].operation != GREATERTHAN) {
+            cout << "A selection predicate must be EQUAL, LESSTHAN or GREATERTHAN" << endl;
+            exit(1);
+        }
+    }
+    if (combination != CONJUNCTION && combination != DISJUNCTION) {
+        cout << "Selection predicates can only be combined with CONJUNCTION or DISJUNCTION" << endl;
+        exit(1);
+    }
+}
+
+/*
+ * Selection kernels.
+ * A kernel evaluates the predicates on tupleCount consecutive tuples (row-major, arity ints per tuple, as in
+ * FLAT_STORAGE and MAPPED_STORAGE) and sets bit i of matchMasks (bit i % 64 of word i / 64) when tuple i matches.
+ * matchMasks has to be zeroed by the caller.
+ *
+ * The AVX2 and AVX-512 kernels load one attribute of 8 / 16 tuples at a time with a strided gather, compare them
+ * all with the operand, and combine the comparison masks of all the predicates, so there is no branch per tuple.
+ * The kernel is chosen once at runtime from what the CPU supports, the scalar kernel is the fallback.
+ */
+enum SelectionKernel {
+    SCALAR_KERNEL,
+    AVX2_KERNEL,
+    AVX512_KERNEL
+};
+
+typedef void (*selectionKernelFunction)(const int* tuples, size_t tupleCount, size_t arity,
+    const predicate* predicates, int predicateCount, int combination, uint64_t* matchMasks);
+
+static void selectionKernelScalar(const int* tuples, size_t tupleCount, size_t arity,
+    const predicate* predicates, int predicateCount, int combination, uint64_t* matchMasks) {
+    for (size_t i = 0; i < tupleCount; ++i)
+        if (predicatesHold(tuples + i * arity, predicates, predicateCount, combination))
+            matchMasks[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+#ifdef RELATIONAL_ALGEBRA_X86
+TARGET_AVX2 static void selectionKernelAvx2(const int* tuples, size_t tupleCount, size_t arity,
+    const predicate* predicates, int predicateCount, int combination, uint64_t* matchMasks) {
+    const __m256i rowOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)arity));
+    size_t i = 0;
+    for (; i + 8 <= tupleCount; i += 8) {
+        const int* block = tuples + i * arity;
+        __m256i combined = (combination == CONJUNCTION) ? _mm256_set1_epi32(-1) : _mm256_setzero_si256();
+        for (int p = 0; p < predicateCount; ++p) {
+            __m256i values = _mm256_i32gather_epi32(block + predicates[p].attributeIndex, rowOffsets, 4);
+            __m256i operand = _mm256_set1_epi32(predicates[p].operand);
+            __m256i condition;
+            if (predicates[p].operation == EQUAL)
+                condition = _mm256_cmpeq_epi32(values, operand);
+            else if (predicates[p].operation == LESSTHAN)
+                condition = _mm256_cmpgt_epi32(operand, values);
+            else
+                condition = _mm256_cmpgt_epi32(values, operand);
+            combined = (combination == CONJUNCTION) ? _mm256_and_si256(combined, condition) : _mm256_or_si256(combined, condition);
+        }
+        uint64_t mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(combined));
+        matchMasks[i / 64] |= mask << (i % 64);
+    }
+    for (; i < tupleCount; ++i)
+        if (predicatesHold(tuples + i * arity, predicates, predicateCount, combination))
+            matchMasks[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+TARGET_AVX512 static void selectionKernelAvx512(const int* tuples, size_t tupleCount, size_t arity,
+    const predicate* predicates, int predicateCount, int combination, uint64_t* matchMasks) {
+    const __m512i rowOffsets = _mm512_mullo_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32((int)arity));
+    size_t i = 0;
+    for (; i + 16 <= tupleCount; i += 16) {
+        const int* block = tuples + i * arity;
+        __mmask16 combined = (combination == CONJUNCTION) ? 0xFFFF : 0;
+        for (int p = 0; p < predicateCount; ++p) {
+            // The masked gather with a zero source is the same load, but does not read an uninitialized register
+            __m512i values = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF, rowOffsets,
+                block + predicates[p].attributeIndex, 4);
+            __m512i operand = _mm512_set1_epi32(predicates[p].operand);
+            __mmask16 condition;
+            if (predicates[p].operation == EQUAL)
+                condition = _mm512_cmpeq_epi32_mask(values, operand);
+            else if (predicates[p].operation == LESSTHAN)
+                condition = _mm512_cmplt_epi32_mask(values, operand);
+            else
+                condition = _mm512_cmpgt_epi32_mask(values, operand);
+            combined = (combination == CONJUNCTION) ? (combined & condition) : (combined | condition);
+        }
+        matchMasks[i / 64] |= (uint64_t)combined << (i % 64);
+    }
+    for (; i < tupleCount; ++i)
+        if (predicatesHold(tuples + i * arity, predicates, predicateCount, combination))
+            matchMasks[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+static bool cpuSupportsKernel(int kernel) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    // The OS has to save the AVX (and for AVX-512 the opmask and ZMM) registers
+    bool osSavesAvx = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    bool osSavesAvx512 = osSavesAvx && (_xgetbv(0) & 0xE0) == 0xE0;
+    __cpuidex(info, 7, 0);
+    if (kernel == AVX2_KERNEL)
+        return osSavesAvx && (info[1] & (1 << 5));
+    if (kernel == AVX512_KERNEL)
+        return osSavesAvx512 && (info[1] & (1 << 16));
+#else
+    if (kernel == AVX2_KERNEL)
+        return __builtin_cpu_supports("avx2");
+    if (kernel == AVX512_KERNEL)
+        return __builtin_cpu_supports("avx512f");
+#endif
+    return kernel == SCALAR_KERNEL;
+}
+#else
+static bool cpuSupportsKernel(int kernel) {return kernel == SCALAR_KERNEL;}
+#endif
+
+static int detectSelectionKernel() {
+    if (cpuSupportsKernel(AVX512_KERNEL))
+        return AVX512_KERNEL;
+    if (cpuSupportsKernel(AVX2_KERNEL))
+        return AVX2_KERNEL;
+    return SCALAR_KERNEL;
+}
+
+static int activeSelectionKernel = detectSelectionKernel();
+
+/*
+ * Forces the selection kernel (e.g. to compare them in a benchmark).
+ * Returns false, and keeps the current kernel, if the CPU does not support it.
+ */
+static bool setSelectionKernel(int kernel) {
+    if (!cpuSupportsKernel(kernel))
+        return false;
+    activeSelectionKernel = kernel;
+    return true;
+}
+
+static int getSelectionKernel() {return activeSelectionKernel;}
+
+static selectionKernelFunction getSelectionKernelFunction() {
+#ifdef RELATIONAL_ALGEBRA_X86
+    if (activeSelectionKernel == AVX512_KERNEL)
+        return selectionKernelAvx512;
+    if (activeSelectionKernel == AVX2_KERNEL)
+        return selectionKernelAvx2;
+#endif
+    return selectionKernelScalar;
+}
+
+static int countTrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (int)index;
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+// Number of tuples whose match bits are computed at once before they are compacted into the output
+const size_t SELECTION_BLOCK_TUPLES = 4096;
+
+/*
+ * Runs the selection kernel over tupleCount contiguous tuples block by block, and calls emit(tuple) for every
+ * matching tuple, in order.
+ */
+template <size_t arity, class Emit>
+static void selectContiguousTuples(const array<int, arity>* tuples, size_t tupleCount,
+    const predicate* predicates, int predicateCount, int combination, Emit emit) {
+    selectionKernelFunction kernel = getSelectionKernelFunction();
+    uint64_t matchMasks[SELECTION_BLOCK_TUPLES / 64];
+    for (size_t blockStart = 0; blockStart < tupleCount; blockStart += SELECTION_BLOCK_TUPLES) {
+        size_t blockTuples = min(SELECTION_BLOCK_TUPLES, tupleCount - blockStart);
+        fill(matchMasks, matchMasks + (blockTuples + 63) / 64, 0);
+        kernel(tuples[blockStart].data(), blockTuples, arity, predicates, predicateCount, combination, matchMasks);
+
+        // Compact the matching tuples into the output
+        for (size_t word = 0; word < (blockTuples + 63) / 64; ++word) {
+            for (uint64_t mask = matchMasks[word]; mask != 0; mask &= mask - 1)
+                emit(tuples[blockStart + word * 64 + countTrailingZeros(mask)]);
+        }
+    }
+}
+
+
+
+// An index lookup fetches its tuples one by one, so it is only used if it returns at most 1 / INDEX_SELECTIVITY_LIMIT of the tuples
+static const int INDEX_SELECTIVITY_LIMIT = 4;
+
+/*
+ * When every predicate has to hold (CONJUNCTION, or a single predicate), finds the predicate with an index on its column
+ * whose lookup returns the fewest tuples, and sets [first, last) to their positions. Returns false if no index can be used.
+ */
+template<size_t arity>
+static bool lookupSelectionIndex(const relation<arity>& inputRelation, const predicate* predicates, int predicateCount, int combination,
+    const int*& first, const int*& last, int& operation) {
+    if (combination != CONJUNCTION && predicateCount != 1)
+        return false;
+    bool found = false;
+    for (int i = 0; i < predicateCount; ++i) {
+        const columnIndex* index = inputRelation.getIndex(predicates[i].attributeIndex);
+        const int *indexFirst, *indexLast;
+        if (index == NULL || !index->lookup(predicates[i].operation, predicates[i].operand, indexFirst, indexLast))
+            continue;
+        if (!found || indexLast - indexFirst < last - first) {
+            first = indexFirst;
+            last = indexLast;
+            operation = predicates[i].operation;
+            found = true;
+        }
+    }
+    return found && (last - first) <= inputRelation.getTupleCount() / INDEX_SELECTIVITY_LIMIT;
+}
+
+/*
+ * Template parameters:
+ *  arity - the arity of both input and output relation
+ *   
+ * Function parameters: 
+ *  inputRelation: this is the input relation on which the selection operation will be applied
+ *  attributeIndex: it is the index of the attribute column on which the selection operation is to be applied
+ *  operation: it can be EQUAL or LESSTHAN or GREATERTHAN
+ *  operand: it the the value against which the attribute value is compared with using the "operation".
+ * 
+ *  For example:
+ *      selection<2>(rel2Arity, 1, GREATERTHAN, 500) -- rel2Arity is a 2-arity (i.e. 2 columns) relation, 
+ *                                                  on which we are applying the selection condition 
+ *                                                  on the second column, and we keep a row/tuple if the
+ *                                                  second column value is greater than 500
+ *      selection<4>(rel4Arity, 3, EQUAL, 200) -- rel4Arity is a 4-arity (i.e. 4 columns) relation, 
+ *                                                  on which we are applying the selection condition 
+ *                                                  on the fourth column, and we keep a row/tuple if the
+ *                                                  fourth column value is equal to 200
+ * 
+ *  Note:
+ *          The arity of the input and outpur relations are the same, therefore the template has only one arity parameter
+ *          attributeIndex staarts from index 0, therefore its value cannot be greater than or equal to inputArity
+ */
+template<size_t arity>
+static relation<arity> selection(const relation<arity>& inputRelation, const predicate* predicates, int predicateCount, int combination);
+
+template<size_t arity>
+static relation<arity> selection(const relation<arity>& inputRelation, int attributeIndex, int operation, int operand) {
+    predicate condition = {attributeIndex, operation, operand};
+    return selection<arity>(inputRelation, &condition, 1, CONJUNCTION);
+}
+
+/*
+ * Multi-predicate selection, evaluated in a single pass over the input relation.
+ *
+ * Function parameters:
+ *  inputRelation: this is the input relation on which the selection operation will be applied
+ *  predicates: an array of (attributeIndex, operation, operand) comparisons, operation is EQUAL, LESSTHAN or GREATERTHAN
+ *  predicateCount: the length of the predicates array
+ *  combination: CONJUNCTION keeps a tuple if all the predicates hold, DISJUNCTION if at least one of them holds
+ *
+ *  For example:
+ *      predicate predicates[2] = {{0, GREATERTHAN, 100}, {2, LESSTHAN, 500}};
+ *      selection<3>(rel3Arity, predicates, 2, CONJUNCTION) -- keeps the tuples whose first column is greater than 100
+ *                                                  and whose third column is less than 500
+ *
+ *  Note:
+ *          FLAT_STORAGE and MAPPED_STORAGE relations are scanned with the vectorized selection kernels,
+ *          TREE_STORAGE relations tuple by tuple
+ *          If a column of a CONJUNCTION has an index (relation::buildIndex) that returns few enough tuples, only
+ *          those tuples are checked
+ */
+template<size_t arity>
+static relation<arity> selection(const relation<arity>& inputRelation, const predicate* predicates, int predicateCount, int combination) {
+    profileScope profile("selection");
+    profile.addInput(inputRelation);
+    checkSelectionPredicates<arity>(predicates, predicateCount, combination);
+
+    const int *indexFirst, *indexLast;
+    int indexOperation;
+    if (lookupSelectionIndex<arity>(inputRelation, predicates, predicateCount, combination, indexFirst, indexLast, indexOperation)) {
+        // The positions of an EQUAL lookup are in increasing order, those of a range are not
+        relationBuilder<arity> outputRelation(inputRelation.getStorageMode(), inputRelation.isSorted() && indexOperation == EQUAL);
+        for (; indexFirst != indexLast; ++indexFirst) {
+            const array<int, arity>& tuple = inputRelation.getTupleAt(*indexFirst);
+            if (predicatesHold(tuple.data(), predicates, predicateCount, combination))
+                outputRelation.insert(tuple);
+        }
+        return profile.finish(outputRelation.build());
+    }
+
+    // A selection keeps the order of the input, so a sorted input gives a sorted output
+    relationBuilder<arity> outputRelation(inputRelation.getStorageMode(), inputRelation.isSorted());
+    inputRelation.visitTupleRange([&](auto first, auto last) {
+        if constexpr (is_pointer<decltype(first)>::value) {
+            selectContiguousTuples<arity>(first, last - first, predicates, predicateCount, combination,
+                [&](const array<int, arity>& tuple) {outputRelation.insert(tuple);});
+        }
+        else {
+            // Iterate through input relation's tuples
+            for (; first != last; ++first) {
+                // Add tuple to the output relation if it satisfies the condition
+                if (predicatesHold(first->data(), predicates, predicateCount, combination))
+                    outputRelation.insert(*first);
+            }
+        }
+    });
+
+    return profile.finish(outputRelation.build());
+}
+
+
+
+/*
+ * Template parameters:
+ *  inputArity - the arity of the input relation
+ *  outputArity - the arity of the output relation
+ *   
+ * Function parameters: 
+ *  inputRelation: this is the input relation on which the projection operation will be applied 
+ *  indicesOfAttributesToKeepArray: this array will store the indices of the attributes that will be kept
+ *                                  the length of the above array is the same as outputArity
+ *  
+ *  For example:
+ *      int indicesOfAttributesToKeepArray[1] = {1};
+ *      auto rel1Arity = projection<2, 1>(rel2Arity, indicesOfAttributesToKeepArray) -  
+ *                                                  rel2Arity is a 2-arity (i.e. 2 columns) relation, 
+ *                                                  on which we are applying the projection operation.
+ *                                                  Out of the two columns, we will keep the second column
+ *                                                  as specified by te indicesOfAttributesToKeepArray array {1}.
+ *                                                  
+ * 
+ *      int indicesOfAttributesToKeepArray[1] = {0, 2, 4};
+ *      auto rel3Arity = projection<5, 3>(rel5Arity, indicesOfAttributesToKeepArray) -
+ *                                                  rel5Arity is a 5-arity (i.e. 5 columns) relation, 
+ *                                                  on which we are applying the projection operation. 
+ *                                                  Out of the five columns, we will keep the first, third and the fifth column
+ *                                                  as specified by te indicesOfAttributesToKeepArray array {0, 2, 4}.
+ * 
+ *  Note:
+ *          The arity of the input and outpur relations are not going to be same, therefore the template has only two arity parameter
+ *          The number of columns we are going to keep is the same as the arity of the output relation, and therefore the size of the
+ *          indicesOfAttributesToKeepArray is outputArity
+ */
+template<size_t inputArity, size_t outputArity>
+static relation<outputArity> projection(const relation<inputArity>& inputRelation, int* indicesOfAttributesToKeepArray) {
+    profileScope profile("projection");
+    profile.addInput(inputRelation);
+    if (inputArity < outputArity) {
+        cout << "You are trying to keep more columns than what exists in the relation" << endl;
+        exit(1);
+    }
+
+    relationBuilder<outputArity> outputRelation(inputRelation.getStorageMode());
+    // Iterate through input relation's tuples
+    inputRelation.forEachTuple([&](const array<int, inputArity>& tuple) {
+        array<int, outputArity> projectedTuple;
+
+        // Populate projected tuple with specified columns
+        for (size_t i = 0; i < outputArity; ++i) {
+            projectedTuple[i] = tuple[indicesOfAttributesToKeepArray[i]];
+        }
+
+        // Insert the projected tuple into the output relation
+        outputRelation.insert(projectedTuple);
+    });
+
+    return profile.finish(outputRelation.build());
+}
+
+/*
+ * The storage mode of the output of a cross product or join: BAG_STORAGE if either input is a bag, so that a
+ * FLAT_STORAGE relation joined with a BAG_STORAGE one keeps the duplicates of the bag, else the storage mode of
+ * inputRelation1.
+ */
+template <size_t inputArity1, size_t inputArity2>
+static int joinOutputStorageMode(const relation<inputArity1>& inputRelation1, const relation<inputArity2>& inputRelation2) {
+    if (inputRelation1.getStorageMode() == BAG_STORAGE || inputRelation2.getStorageMode() == BAG_STORAGE)
+        return BAG_STORAGE;
+    return inputRelation1.getStorageMode();
+}
+
+
+/*
+ * 
+ * Cross-product (cartesian-product) takes as input two relation, inputRelation1 and inputRelation2
+ * Template parameters:
+ *  inputArity1 - the arity of the input relation inputRelation1
+ *  inputArity2 - the arity of the input relation inputRelation2
+ *   
+ * Function parameters: 
+ *  inputRelation1: the first input relations
+ *  inputRelation2: the second input relations
+ * 
+ *  For example:
+ *      auto rel5Arity = crossProduct<2, 3>(rel2Arity, rel3Arity) -  
+ *                                                  rel2Arity is a 2-arity (i.e. 2 columns) relation, 
+ *                                                  and, rel3Arity is a3-arity (i.e. 3 columns) relation
+ *                                                  The output is going to be a 5 arity relation
+ *                                                  
+ * 
+ *  Note:
+ *          The arity of the two input relations do not have to be same, therefore the template has two arity parameters for the two input relations
+ *          The arity of the output relation can be computed using the arities of the input relations (inputArity1 + inputArity2)
+ */
+template <size_t inputArity1, size_t inputArity2>
+static relation<inputArity1 + inputArity2> crossProduct(const relation<inputArity1>& inputRelation1, const relation<inputArity2>& inputRelation2) {
+    profileScope profile("crossProduct");
+    profile.addInput(inputRelation1);
+    profile.addInput(inputRelation2);
+    relationBuilder<inputArity1 + inputArity2> outputRelation(joinOutputStorageMode(inputRelation1, inputRelation2));
+
+    inputRelation1.forEachTuple([&](const array<int, inputArity1>& tuple1) {
+        inputRelation2.forEachTuple([&](const array<int, inputArity2>& tuple2) {
+            array<int, inputArity1 + inputArity2> combinedTuple;
+
+            for (size_t i = 0; i < inputArity1; ++i) {
+                combinedTuple[i] = tuple1[i];
+            }
+            for (size_t i = 0; i < inputArity2; ++i) {
+                combinedTuple[inputArity1 + i] = tuple2[i];
+            }
+            outputRelation.insert(combinedTuple);
+        });
+    });
+
+    return profile.finish(outputRelation.build());
+}
+
+
+
+/*
+ * 
+ * Equi-Join
+ * Template parameters:
+ *  inputArity1 - the arity of the input relation inputRelation1
+ *  inputArity2 - the arity of the input relation inputRelation2
+ *   
+ * Function parameters: 
+ *  inputRelation1: the first input relations
+ *  inputRelation2: the second input relations
+ *  joinColumnIndexLength - the number of columns on which the join (equality) will be performed
+ *  relation1JoinColumnIndexArray - an array that stores the indices of the columns of relation 1 on which join will be performed
+ *  relation2JoinColumnIndexArray - an array that stores the indices of the columns of relation 2 on which join will be performed 
+ *  
+ * 
+ *  For example:
+ *      int relation1JoinIndex[1] = {0};
+ *      int relation2JoinIndex[1] = {1};
+ *      auto rel5Arity = equiJoinQuadratic<2, 3>(rel2Arity, rel3Arity, 1, relation1JoinIndex, relation2JoinIndex) -  
+ *                                                  rel2Arity is a 2-arity (i.e. 2 columns) relation, 
+ *                                                  and, rel3Arity is a3-arity (i.e. 3 columns) relation
+ *                                                  The output is going to be a 5 arity relation (rel5Arity).
+ *                                                  Equality will be checked on one column. The first column of relations1,
+ *                                                  the second column of relation2.
+ *                                                  
+ * 
+ *  Note:
+ *          The arity of the two input relations do not have to be same, therefore the template has two arity parameters for the two input relations
+ *          The arity of the output relation can be computed using the arities of the input relations (inputArity1 + inputArity2)
+ */
+template <size_t inputArity1, size_t inputArity2>
+static relation<inputArity1 + inputArity2> equiJoinQuadratic(const relation<inputArity1>& inputRelation1, const relation<inputArity2>& inputRelation2,
+    int joinColumnIndexLength, int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray) {
+    profileScope profile("equiJoinQuadratic");
+    profile.addInput(inputRelation1);
+    profile.addInput(inputRelation2);
+    relationBuilder<inputArity1 + inputArity2> outputRelation(joinOutputStorageMode(inputRelation1, inputRelation2));
+
+    inputRelation1.forEachTuple([&](const array<int, inputArity1>& tuple1) {
+        inputRelation2.forEachTuple([&](const array<int, inputArity2>& tuple2) {
+            bool match = true;
+
+            for (int i = 0; i < joinColumnIndexLength; ++i) {
+                if (tuple1[relation1JoinColumnIndexArray[i]] != tuple2[relation2JoinColumnIndexArray[i]]) {
+                    match = false;
+                    break;
+                }
+            }
+
+            if (match) {
+                array<int, inputArity1 + inputArity2> combinedTuple;
+
+                for (size_t i = 0; i < inputArity1; ++i) {
+                    combinedTuple[i] = tuple1[i];
+                }
+                for (size_t i = 0; i < inputArity2; ++i) {
+                    combinedTuple[inputArity1 + i] = tuple2[i];
+                }
+                outputRelation.insert(combinedTuple);
+            }
+        });
+    });
+
+    return profile.finish(outputRelation.build());
+}
+
+
+
+/*
+ * Hashes the join key of a tuple (the values of its join columns).
+ * Keys are stored in a fixed size array so that multi-column keys do not need a heap allocation;
+ * the slots after joinColumnIndexLength are always 0 and do not change the result.
+ */
+template <size_t keyArity>
+struct joinKeyHash
+{
+    size_t operator()(const array<int, keyArity>& key) const {
+        size_t seed = 0;
+        for (size_t i = 0; i < keyArity; ++i)
+            seed ^= hash<int>()(key[i]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        return seed;
+    }
+};
+
+template <size_t keyArity, size_t arity>
+static array<int, keyArity> extractJoinKey(const array<int, arity>& tuple, int joinColumnIndexLength, const int* joinColumnIndexArray) {
+    array<int, keyArity> key{};
+    for (int i = 0; i < joinColumnIndexLength; ++i)
+        key[i] = tuple[joinColumnIndexArray[i]];
+    return key;
+}
+
+template <size_t inputArity1, size_t inputArity2>
+static array<int, inputArity1 + inputArity2> concatenateTuples(const array<int, inputArity1>& tuple1, const array<int, inputArity2>& tuple2) {
+    array<int, inputArity1 + inputArity2> combinedTuple;
+    for (size_t i = 0; i < inputArity1; ++i)
+        combinedTuple[i] = tuple1[i];
+    for (size_t i = 0; i < inputArity2; ++i)
+        combinedTuple[inputArity1 + i] = tuple2[i];
+    return combinedTuple;
+}
+
+// Join key -> pointers to the tuples of the build side relation that have that key. The vectors of the keys are
+// allocated from the memory resource of the table
+template <size_t keyArity, size_t arity>
+using joinHashTable = pmr::unordered_map<array<int, keyArity>, pmr::vector<const array<int, arity>*>, joinKeyHash<keyArity>>;
+
+template <size_t keyArity, size_t arity>
+static joinHashTable<keyArity, arity> buildJoinHashTable(const relation<arity>& buildRelation,
+    int joinColumnIndexLength, const int* joinColumnIndexArray, pmr::memory_resource* resource = queryMemoryResource()) {
+    joinHashTable<keyArity, arity> hashTable(resource);
+    hashTable.reserve(buildRelation.getTupleCount());
+    buildRelation.forEachTuple([&](const array<int, arity>& tuple) {
+        hashTable[extractJoinKey<keyArity>(tuple, joinColumnIndexLength, joinColumnIndexArray)].push_back(&tuple);
+    });
+    return hashTable;
+}
+
+/*
+ * 
+ * Equi-Join (hash join)
+ * Takes exactly the same parameters as equiJoinQuadratic and produces the same output relation.
+ *
+ * Instead of comparing every pair of tuples, a hash table is built on the join columns of the smaller
+ * input relation (build side), and every tuple of the other relation (probe side) looks up its join key in it.
+ * The cost is O(n + m + output) instead of O(n * m).
+ *
+ *  For example:
+ *      int relation1JoinIndex[2] = {0, 2};
+ *      int relation2JoinIndex[2] = {1, 0};
+ *      auto rel5Arity = equiJoinHash<3, 2>(rel3Arity, rel2Arity, 2, relation1JoinIndex, relation2JoinIndex) -
+ *                                                  joins on two columns, the first and third column of rel3Arity
+ *                                                  are compared with the second and first column of rel2Arity
+ *
+ *  Note:
+ *          joinColumnIndexLength cannot be greater than the arity of either input relation
+ *          The output tuples are always (tuple of relation 1, tuple of relation 2), whichever side the hash table is built on
+ *          If a relation has an index on its first join column, no hash table is built: the other relation probes the index
+ */
+template <size_t inputArity1, size_t inputArity2>
+static relation<inputArity1 + inputArity2> equiJoinHash(const relation<inputArity1>& inputRelation1, const relation<inputArity2>& inputRelation2,
+    int joinColumnIndexLength, int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray) {
+    profileScope profile("equiJoinHash");
+    profile.addInput(inputRelation1);
+    profile.addInput(inputRelation2);
+    constexpr size_t keyArity = inputArity1 < inputArity2 ? inputArity1 : inputArity2;
+    if (joinColumnIndexLength < 0 || joinColumnIndexLength > (int)keyArity) {
+        cout << "You are trying to join on more columns than what exists in the relations" << endl;
+        exit(1);
+    }
+
+    relationBuilder<inputArity1 + inputArity2> outputRelation(joinOutputStorageMode(inputRelation1, inputRelation2));
+
+    // With indexes on both sides, the index of the bigger relation is probed by the smaller one
+    const columnIndex* index1 = (joinColumnIndexLength > 0) ? inputRelation1.getIndex(relation1JoinColumnIndexArray[0]) : NULL;
+    const columnIndex* index2 = (joinColumnIndexLength > 0) ? inputRelation2.getIndex(relation2JoinColumnIndexArray[0]) : NULL;
+    if (index1 != NULL && (index2 == NULL || inputRelation1.getTupleCount() >= inputRelation2.getTupleCount())) {
+        inputRelation2.forEachTuple([&](const array<int, inputArity2>& tuple2) {
+            const int *first, *last;
+            index1->lookup(EQUAL, tuple2[relation2JoinColumnIndexArray[0]], first, last);
+            if (first == last)
+                return;
+            // The index only matches the first join column
+            auto joinKey = extractJoinKey<keyArity>(tuple2, joinColumnIndexLength, relation2JoinColumnIndexArray);
+            for (; first != last; ++first) {
+                const auto& tuple1 = inputRelation1.getTupleAt(*first);
+                if (extractJoinKey<keyArity>(tuple1, joinColumnIndexLength, relation1JoinColumnIndexArray) == joinKey)
+                    outputRelation.insert(concatenateTuples<inputArity1, inputArity2>(tuple1, tuple2));
+            }
+        });
+        return profile.finish(outputRelation.build());
+    }
+    if (index2 != NULL) {
+        inputRelation1.forEachTuple([&](const array<int, inputArity1>& tuple1) {
+            const int *first, *last;
+            index2->lookup(EQUAL, tuple1[relation1JoinColumnIndexArray[0]], first, last);
+            if (first == last)
+                return;
+            auto joinKey = extractJoinKey<keyArity>(tuple1, joinColumnIndexLength, relation1JoinColumnIndexArray);
+            for (; first != last; ++first) {
+                const auto& tuple2 = inputRelation2.getTupleAt(*first);
+                if (extractJoinKey<keyArity>(tuple2, joinColumnIndexLength, relation2JoinColumnIndexArray) == joinKey)
+                    outputRelation.insert(concatenateTuples<inputArity1, inputArity2>(tuple1, tuple2));
+            }
+        });
+        return profile.finish(outputRelation.build());
+    }
+
+    // The hash table keeps pointers to the tuples of the build side relation
+    if (inputRelation1.getTupleCount() <= inputRelation2.getTupleCount()) {
+        auto hashTable = buildJoinHashTable<keyArity>(inputRelation1, joinColumnIndexLength, relation1JoinColumnIndexArray);
+
+        inputRelation2.forEachTuple([&](const array<int, inputArity2>& tuple2) {
+            auto bucket = hashTable.find(extractJoinKey<keyArity>(tuple2, joinColumnIndexLength, relation2JoinColumnIndexArray));
+            if (bucket == hashTable.end())
+                return;
+            for (const auto* tuple1 : bucket->second)
+                outputRelation.insert(concatenateTuples<inputArity1, inputArity2>(*tuple1, tuple2));
+        });
+    }
+    else {
+        auto hashTable = buildJoinHashTable<keyArity>(inputRelation2, joinColumnIndexLength, relation2JoinColumnIndexArray);
+
+        inputRelation1.forEachTuple([&](const array<int, inputArity1>& tuple1) {
+            auto bucket = hashTable.find(extractJoinKey<keyArity>(tuple1, joinColumnIndexLength, relation1JoinColumnIndexArray));
+            if (bucket == hashTable.end())
+                return;
+            for (const auto* tuple2 : bucket->second)
+                outputRelation.insert(concatenateTuples<inputArity1, inputArity2>(tuple1, *tuple2));
+        });
+    }
+
+    return profile.finish(outputRelation.build());
+}
+
+
+
+/*
+ * Compares two tuples (possibly of different arity, passed as tuple.data()) on their join columns only.
+ * Returns a negative value, 0 or a positive value like strcmp.
+ */
+static int compareJoinKeys(const int* tuple1, const int* tuple2,
+    int joinColumnIndexLength, const int* joinColumnIndexArray1, const int* joinColumnIndexArray2) {
+    for (int i = 0; i < joinColumnIndexLength; ++i) {
+        int value1 = tuple1[joinColumnIndexArray1[i]];
+        int value2 = tuple2[joinColumnIndexArray2[i]];
+        if (value1 != value2)
+            return value1 < value2 ? -1 : 1;
+    }
+    return 0;
+}
+
+/*
+ * The join columns are a prefix of the tuple ({0}, {0, 1}, ...), i.e. the lexicographic order of dataBuffer
+ * is already sorted by the join key.
+ */
+static bool isJoinKeyPrefix(int joinColumnIndexLength, const int* joinColumnIndexArray) {
+    for (int i = 0; i < joinColumnIndexLength; ++i)
+        if (joinColumnIndexArray[i] != i)
+            return false;
+    return true;
+}
+
+// Number of tuples an externalSorter keeps in memory before it spills a sorted run to disk
+const size_t DEFAULT_SORT_MEMORY_BUDGET = 1 << 20;
+
+/*
+ * External merge sort of tuples by key columns.
+ *
+ * Tuples are added with add(); at most memoryBudgetTuples tuples are kept in memory, when the buffer is full it is
+ * sorted and written to a temporary file (a sorted run). After finish(), next() returns the tuples in sorted order
+ * by k-way merging the runs, reading every run in blocks so that the merge also stays within memoryBudgetTuples.
+ * If nothing was spilled the tuples are returned directly from memory.
+ *
+ * The order is the key columns first (in the order of keyColumnIndexArray) and then the whole tuple, so equal
+ * tuples come out next to each other.
+ */
+template <size_t arity>
+class externalSorter
+{
+private:
+    struct runCursor {
+        FILE* file;
+        vector<array<int, arity>> block;
+        size_t position;
+    };
+
+    int keyLength;
+    const int* keyColumnIndexArray;
+    size_t memoryBudgetTuples;
+    vector<array<int, arity>> buffer;
+    size_t bufferPosition;
+    vector<FILE*> runs;
+    vector<runCursor> cursors;
+    vector<size_t> mergeHeap;
+
+    bool less(const array<int, arity>& tuple1, const array<int, arity>& tuple2) const {
+        int keyOrder = compareJoinKeys(tuple1.data(), tuple2.data(), keyLength, keyColumnIndexArray, keyColumnIndexArray);
+        if (keyOrder != 0)
+            return keyOrder < 0;
+        return tuple1 < tuple2;
+    }
+    void sortBuffer() {
+        sort(buffer.begin(), buffer.end(), [this](const array<int, arity>& tuple1, const array<int, arity>& tuple2) {
+            return less(tuple1, tuple2);
+        });
+    }
+    void spillRun();
+    bool refill(runCursor& cursor);
+
+public:
+    externalSorter(int keyLength, const int* keyColumnIndexArray, size_t memoryBudgetTuples = DEFAULT_SORT_MEMORY_BUDGET)
+        : keyLength(keyLength), keyColumnIndexArray(keyColumnIndexArray),
+          memoryBudgetTuples(memoryBudgetTuples > 0 ? memoryBudgetTuples : 1), bufferPosition(0) {}
+    externalSorter(const externalSorter&) = delete;
+    externalSorter& operator=(const externalSorter&) = delete;
+    ~externalSorter() {
+        for (FILE* run : runs)
+            fclose(run);
+    }
+
+    void add(const array<int, arity>& tuple) {
+        buffer.push_back(tuple);
+        if (buffer.size() >= memoryBudgetTuples)
+            spillRun();
+    }
+    void finish();
+    bool next(array<int, arity>& tuple);
+    size_t getRunCount() {return runs.size();}
+};
+
+template <size_t arity>
+void externalSorter<arity>::spillRun()
+{
+    sortBuffer();
+    FILE* run = tmpfile();
+    if (run == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    if (fwrite(buffer.data(), sizeof(array<int, arity>), buffer.size(), run) != buffer.size())
+    {
+        cout << "File writing error" << endl;
+        exit(1);
+    }
+    runs.push_back(run);
+    buffer.clear();
+}
+
+template <size_t arity>
+bool externalSorter<arity>::refill(runCursor& cursor)
+{
+    size_t blockTuples = memoryBudgetTuples / runs.size();
+    cursor.block.resize(blockTuples > 0 ? blockTuples : 1);
+    size_t readTuples = fread(cursor.block.data(), sizeof(array<int, arity>), cursor.block.size(), cursor.file);
+    cursor.block.resize(readTuples);
+    cursor.position = 0;
+    return readTuples > 0;
+}
+
+template <size_t arity>
+void externalSorter<arity>::finish()
+{
+    if (runs.empty()) {
+        sortBuffer();
+        return;
+    }
+    if (!buffer.empty())
+        spillRun();
+    buffer.shrink_to_fit();
+
+    cursors.resize(runs.size());
+    for (size_t i = 0; i < runs.size(); ++i) {
+        rewind(runs[i]);
+        cursors[i].file = runs[i];
+        if (refill(cursors[i]))
+            mergeHeap.push_back(i);
+    }
+    auto heapOrder = [this](size_t run1, size_t run2) {
+        return less(cursors[run2].block[cursors[run2].position], cursors[run1].block[cursors[run1].position]);
+    };
+    make_heap(mergeHeap.begin(), mergeHeap.end(), heapOrder);
+}
+
+template <size_t arity>
+bool externalSorter<arity>::next(array<int, arity>& tuple)
+{
+    if (runs.empty()) {
+        if (bufferPosition >= buffer.size())
+            return false;
+        tuple = buffer[bufferPosition++];
+        return true;
+    }
+
+    if (mergeHeap.empty())
+        return false;
+    auto heapOrder = [this](size_t run1, size_t run2) {
+        return less(cursors[run2].block[cursors[run2].position], cursors[run1].block[cursors[run1].position]);
+    };
+    pop_heap(mergeHeap.begin(), mergeHeap.end(), heapOrder);
+    runCursor& cursor = cursors[mergeHeap.back()];
+    tuple = cursor.block[cursor.position++];
+    if (cursor.position < cursor.block.size() || refill(cursor))
+        push_heap(mergeHeap.begin(), mergeHeap.end(), heapOrder);
+    else
+        mergeHeap.pop_back();
+    return true;
+}
+
+/*
+ * The tuples of the second input of a merge join that share the current join key.
+ * At most memoryBudgetTuples of them are kept in memory: a larger group (e.g. when every tuple has the same key, like
+ * case 1) is spilled to a temporary file, which forEachTuple reads back in blocks of memoryBudgetTuples tuples for
+ * every matching tuple of the first input. The file is reused by the following groups.
+ */
+template <size_t arity>
+class joinGroupBuffer
+{
+private:
+    size_t memoryBudgetTuples;
+    vector<array<int, arity>> tuples;
+    FILE* spillFile;
+    size_t spilledTupleCount;
+
+    void spill() {
+        if (spillFile == NULL) {
+            spillFile = tmpfile();
+            if (spillFile == NULL)
+            {
+                fputs("File error", stderr);
+                exit(1);
+            }
+        }
+        if (fwrite(tuples.data(), sizeof(array<int, arity>), tuples.size(), spillFile) != tuples.size())
+        {
+            cout << "File writing error" << endl;
+            exit(1);
+        }
+        spilledTupleCount += tuples.size();
+        tuples.clear();
+    }
+
+public:
+    explicit joinGroupBuffer(size_t memoryBudgetTuples)
+        : memoryBudgetTuples(memoryBudgetTuples > 0 ? memoryBudgetTuples : 1), spillFile(NULL), spilledTupleCount(0) {}
+    joinGroupBuffer(const joinGroupBuffer&) = delete;
+    joinGroupBuffer& operator=(const joinGroupBuffer&) = delete;
+    ~joinGroupBuffer() {
+        if (spillFile != NULL)
+            fclose(spillFile);
+    }
+
+    void clear() {
+        tuples.clear();
+        spilledTupleCount = 0;
+        if (spillFile != NULL)
+            rewind(spillFile);
+    }
+    void add(const array<int, arity>& tuple) {
+        tuples.push_back(tuple);
+        if (tuples.size() >= memoryBudgetTuples)
+            spill();
+    }
+
+    // Calls function(tuple) for every tuple of the group; no tuple may be added until the next clear()
+    template <class F>
+    void forEachTuple(F function) {
+        if (spilledTupleCount == 0) {
+            for (const auto& tuple : tuples)
+                function(tuple);
+            return;
+        }
+        if (!tuples.empty())
+            spill();
+        rewind(spillFile);
+        for (size_t readTuples = 0; readTuples < spilledTupleCount; ) {
+            tuples.resize(min(memoryBudgetTuples, spilledTupleCount - readTuples));
+            if (fread(tuples.data(), sizeof(array<int, arity>), tuples.size(), spillFile) != tuples.size())
+            {
+                cout << "File reading error" << endl;
+                exit(1);
+            }
+            readTuples += tuples.size();
+            for (const auto& tuple : tuples)
+                function(tuple);
+        }
+        tuples.clear();
+    }
+};
+
+/*
+ * Merges two streams of tuples that are sorted by their join keys, and calls emit for every pair with equal keys.
+ * next1/next2 are called as next(tuple) and return false at the end of the stream.
+ * Only the tuples of the second stream that share the current join key are buffered, at most memoryBudgetTuples of
+ * them in memory (see joinGroupBuffer).
+ */
+template <size_t inputArity1, size_t inputArity2, class Next1, class Next2, class Emit>
+static void mergeJoinSortedStreams(Next1 next1, Next2 next2,
+    int joinColumnIndexLength, const int* relation1JoinColumnIndexArray, const int* relation2JoinColumnIndexArray, Emit emit,
+    size_t memoryBudgetTuples = DEFAULT_SORT_MEMORY_BUDGET) {
+    array<int, inputArity1> tuple1;
+    array<int, inputArity2> tuple2;
+    // The first tuple of the current group, whose join key the other tuples are compared with
+    array<int, inputArity2> groupTuple2;
+    joinGroupBuffer<inputArity2> group2(memoryBudgetTuples);
+    bool hasTuple1 = next1(tuple1);
+    bool hasTuple2 = next2(tuple2);
+
+    while (hasTuple1 && hasTuple2) {
+        int keyOrder = compareJoinKeys(tuple1.data(), tuple2.data(),
+            joinColumnIndexLength, relation1JoinColumnIndexArray, relation2JoinColumnIndexArray);
+        if (keyOrder < 0) {
+            hasTuple1 = next1(tuple1);
+        }
+        else if (keyOrder > 0) {
+            hasTuple2 = next2(tuple2);
+        }
+        else {
+            group2.clear();
+            groupTuple2 = tuple2;
+            do {
+                group2.add(tuple2);
+                hasTuple2 = next2(tuple2);
+            } while (hasTuple2 && compareJoinKeys(groupTuple2.data(), tuple2.data(),
+                         joinColumnIndexLength, relation2JoinColumnIndexArray, relation2JoinColumnIndexArray) == 0);
+
+            do {
+                group2.forEachTuple([&](const array<int, inputArity2>& groupTuple) {emit(tuple1, groupTuple);});
+                hasTuple1 = next1(tuple1);
+            } while (hasTuple1 && compareJoinKeys(tuple1.data(), groupTuple2.data(),
+                         joinColumnIndexLength, relation1JoinColumnIndexArray, relation2JoinColumnIndexArray) == 0);
+        }
+    }
+}
+
+/*
+ * 
+ * Equi-Join (sort-merge join)
+ * Takes the same parameters as equiJoinQuadratic (plus an optional memory budget) and produces the same output relation.
+ *
+ * If the join columns of a relation are a prefix of its columns (e.g. {0} or {0, 1}), its tuples are already in
+ * join key order and are merged directly. Otherwise (and always for MAPPED_STORAGE, which is in file order) that
+ * relation is first sorted into join key order with an externalSorter, which spills sorted runs to temporary files
+ * once memoryBudgetTuples tuples are buffered. A group of tuples of inputRelation2 with the same join key that is
+ * larger than memoryBudgetTuples is spilled as well, so the memory used does not depend on the key distribution.
+ *
+ *  For example:
+ *      int relation1JoinIndex[1] = {0};
+ *      int relation2JoinIndex[1] = {0};
+ *      auto rel5Arity = equiJoinSortMerge<2, 3>(rel2Arity, rel3Arity, 1, relation1JoinIndex, relation2JoinIndex) -
+ *                                                  both relations are joined on their first column, so no sorting is needed
+ *
+ *      int relation2JoinIndex[1] = {2};
+ *      auto rel5Arity = equiJoinSortMerge<2, 3>(rel2Arity, rel3Arity, 1, relation1JoinIndex, relation2JoinIndex, 100000) -
+ *                                                  rel3Arity is sorted on its third column first, keeping at most
+ *                                                  100000 tuples in memory at a time
+ */
+template <size_t inputArity1, size_t inputArity2>
+static relation<inputArity1 + inputArity2> equiJoinSortMerge(const relation<inputArity1>& inputRelation1, const relation<inputArity2>& inputRelation2,
+    int joinColumnIndexLength, int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray,
+    size_t memoryBudgetTuples = DEFAULT_SORT_MEMORY_BUDGET) {
+    profileScope profile("equiJoinSortMerge");
+    profile.addInput(inputRelation1);
+    profile.addInput(inputRelation2);
+    if (joinColumnIndexLength < 0 || joinColumnIndexLength > (int)inputArity1 || joinColumnIndexLength > (int)inputArity2) {
+        cout << "You are trying to join on more columns than what exists in the relations" << endl;
+        exit(1);
+    }
+
+    relationBuilder<inputArity1 + inputArity2> outputRelation(joinOutputStorageMode(inputRelation1, inputRelation2));
+
+    bool sorted1 = inputRelation1.isSorted() && isJoinKeyPrefix(joinColumnIndexLength, relation1JoinColumnIndexArray);
+    bool sorted2 = inputRelation2.isSorted() && isJoinKeyPrefix(joinColumnIndexLength, relation2JoinColumnIndexArray);
+    externalSorter<inputArity1> sorter1(joinColumnIndexLength, relation1JoinColumnIndexArray, memoryBudgetTuples);
+    externalSorter<inputArity2> sorter2(joinColumnIndexLength, relation2JoinColumnIndexArray, memoryBudgetTuples);
+    if (!sorted1) {
+        inputRelation1.forEachTuple([&](const array<int, inputArity1>& tuple1) {sorter1.add(tuple1);});
+        sorter1.finish();
+    }
+    if (!sorted2) {
+        inputRelation2.forEachTuple([&](const array<int, inputArity2>& tuple2) {sorter2.add(tuple2);});
+        sorter2.finish();
+    }
+
+    inputRelation1.visitTupleRange([&](auto first1, auto last1) {
+        inputRelation2.visitTupleRange([&](auto first2, auto last2) {
+            auto next1 = [&](array<int, inputArity1>& tuple1) {
+                if (!sorted1)
+                    return sorter1.next(tuple1);
+                if (first1 == last1)
+                    return false;
+                tuple1 = *first1++;
+                return true;
+            };
+            auto next2 = [&](array<int, inputArity2>& tuple2) {
+                if (!sorted2)
+                    return sorter2.next(tuple2);
+                if (first2 == last2)
+                    return false;
+                tuple2 = *first2++;
+                return true;
+            };
+
+            mergeJoinSortedStreams<inputArity1, inputArity2>(next1, next2,
+                joinColumnIndexLength, relation1JoinColumnIndexArray, relation2JoinColumnIndexArray,
+                [&](const array<int, inputArity1>& tuple1, const array<int, inputArity2>& tuple2) {
+                    outputRelation.insert(concatenateTuples<inputArity1, inputArity2>(tuple1, tuple2));
+                }, memoryBudgetTuples);
+        });
+    });
+
+    return profile.finish(outputRelation.build());
+}
+
+
+
+/*
+ * A fixed set of worker threads with one task queue per worker and work stealing.
+ *
+ * run(taskCount, task) calls task(0) ... task(taskCount - 1) on the workers and returns when all of them are done.
+ * The tasks are dealt round-robin to the worker queues; a worker takes tasks from the front of its own queue, and
+ * when it is empty steals from the back of the other queues, so a few slow (e.g. skewed) partitions do not leave
+ * the other threads idle. run() must not be called from inside a task.
+ */
+class threadPool
+{
+private:
+    struct workerQueue {
+        mutex queueMutex;
+        deque<function<void()>> tasks;
+    };
+
+    vector<thread> workers;
+    vector<unique_ptr<workerQueue>> queues;
+    mutex stateMutex;
+    condition_variable workAvailable;
+    condition_variable workFinished;
+    size_t queuedTasks;      // tasks in the queues that no worker has claimed yet
+    size_t unfinishedTasks;  // tasks of the current run() that have not finished yet
+    bool stopping;
+
+    bool takeTask(size_t workerIndex, function<void()>& task);
+    void workerLoop(size_t workerIndex);
+
+public:
+    explicit threadPool(size_t threadCount = thread::hardware_concurrency());
+    threadPool(const threadPool&) = delete;
+    threadPool& operator=(const threadPool&) = delete;
+    ~threadPool();
+
+    size_t getThreadCount() const {return workers.size();}
+    void run(size_t taskCount, const function<void(size_t)>& task);
+};
+
+threadPool::threadPool(size_t threadCount)
+{
+    queuedTasks = 0;
+    unfinishedTasks = 0;
+    stopping = false;
+    if (threadCount == 0)
+        threadCount = 1;
+    for (size_t i = 0; i < threadCount; ++i)
+        queues.push_back(make_unique<workerQueue>());
+    for (size_t i = 0; i < threadCount; ++i)
+        workers.emplace_back(&threadPool::workerLoop, this, i);
+}
+
+threadPool::~threadPool()
+{
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+bool threadPool::takeTask(size_t workerIndex, function<void()>& task)
+{
+    for (size_t i = 0; i < queues.size(); ++i) {
+        workerQueue& queue = *queues[(workerIndex + i) % queues.size()];
+        lock_guard<mutex> lock(queue.queueMutex);
+        if (queue.tasks.empty())
+            continue;
+        // Own queue from the front, stolen tasks from the back
+        if (i == 0) {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        else {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+void threadPool::workerLoop(size_t workerIndex)
+{
+    for (;;) {
+        {
+            // Claim one of the queued tasks first, so that the search below is guaranteed to find one
+            unique_lock<mutex> lock(stateMutex);
+            workAvailable.wait(lock, [this]() {return stopping || queuedTasks > 0;});
+            if (queuedTasks == 0)
+                return;
+            --queuedTasks;
+        }
+
+        function<void()> task;
+        while (!takeTask(workerIndex, task))
+            this_thread::yield();
+        task();
+
+        lock_guard<mutex> lock(stateMutex);
+        if (--unfinishedTasks == 0)
+            workFinished.notify_all();
+    }
+}
+
+void threadPool::run(size_t taskCount, const function<void(size_t)>& task)
+{
+    if (taskCount == 0)
+        return;
+    for (size_t i = 0; i < taskCount; ++i) {
+        workerQueue& queue = *queues[i % queues.size()];
+        lock_guard<mutex> lock(queue.queueMutex);
+        queue.tasks.push_back([&task, i]() {task(i);});
+    }
+
+    unique_lock<mutex> lock(stateMutex);
+    queuedTasks += taskCount;
+    unfinishedTasks += taskCount;
+    workAvailable.notify_all();
+    workFinished.wait(lock, [this]() {return unfinishedTasks == 0;});
+}
+
+/*
+ * Splits the tuples of inputRelation into about partitionsPerThread partitions per thread (more partitions than
+ * threads so that work stealing can even out skew), and calls function(first, last, partitionOutput) for every
+ * partition on the thread pool. Returns the output tuples of all the partitions.
+ *
+ * The partition boundaries of a FLAT_STORAGE or MAPPED_STORAGE relation are computed directly; a TREE_STORAGE
+ * relation is walked once to find them.
+ */
+const size_t PARTITIONS_PER_THREAD = 4;
+
+template <size_t arity>
+static size_t getPartitionCount(const relation<arity>& inputRelation, threadPool& pool) {
+    size_t partitionCount = pool.getThreadCount() * PARTITIONS_PER_THREAD;
+    if (partitionCount > (size_t)inputRelation.getTupleCount())
+        partitionCount = inputRelation.getTupleCount() > 0 ? inputRelation.getTupleCount() : 1;
+    return partitionCount;
+}
+
+// Calls function(partition, first, last) for each of the partitionCount partitions of inputRelation, on the thread pool
+template <size_t arity, class F>
+static void forEachPartition(const relation<arity>& inputRelation, size_t partitionCount, threadPool& pool, F function) {
+    inputRelation.visitTupleRange([&](auto first, auto last) {
+        size_t tupleCount = distance(first, last);
+        vector<decltype(first)> boundaries;
+        auto boundary = first;
+        for (size_t i = 0; i < partitionCount; ++i) {
+            boundaries.push_back(boundary);
+            advance(boundary, tupleCount * (i + 1) / partitionCount - tupleCount * i / partitionCount);
+        }
+        boundaries.push_back(last);
+
+        pool.run(partitionCount, [&](size_t partition) {
+            function(partition, boundaries[partition], boundaries[partition + 1]);
+        });
+    });
+}
+
+template <size_t outputArity, size_t arity, class F>
+static vector<vector<array<int, outputArity>>> runPartitioned(const relation<arity>& inputRelation, threadPool& pool, F function) {
+    size_t partitionCount = getPartitionCount(inputRelation, pool);
+    vector<vector<array<int, outputArity>>> partitionOutputs(partitionCount);
+    forEachPartition(inputRelation, partitionCount, pool, [&](size_t partition, auto first, auto last) {
+        function(first, last, partitionOutputs[partition]);
+    });
+    return partitionOutputs;
+}
+
+/*
+ * Merges the per-partition outputs of a parallel operator into one relation of the given storage mode.
+ * Every partition is sorted and deduplicated on its own thread, then the partitions are merged pairwise
+ * (also in parallel) until one sorted and deduplicated array is left.
+ * A BAG_STORAGE output keeps every tuple, so its partitions are only concatenated in partition order. So are the
+ * partitions of an operator that keeps the order of a sorted input (orderedPartitions, e.g. a selection): they are
+ * already sorted, deduplicated and in order.
+ */
+template <size_t arity>
+static relation<arity> mergePartitionOutputs(vector<vector<array<int, arity>>> partitionOutputs, int storageMode, threadPool& pool,
+    bool orderedPartitions = false) {
+    vector<array<int, arity>> tuples;
+    if (storageMode == BAG_STORAGE || orderedPartitions) {
+        size_t tupleCount = 0;
+        for (const auto& partitionTuples : partitionOutputs)
+            tupleCount += partitionTuples.size();
+        tuples.reserve(tupleCount);
+        for (auto& partitionTuples : partitionOutputs) {
+            tuples.insert(tuples.end(), partitionTuples.begin(), partitionTuples.end());
+            vector<array<int, arity>>().swap(partitionTuples);
+        }
+        if (storageMode == BAG_STORAGE) {
+            auto outputRelation = relation<arity>();
+            outputRelation.setBagBuffer(move(tuples));
+            return outputRelation;
+        }
+        partitionOutputs.clear();
+    }
+
+    pool.run(partitionOutputs.size(), [&](size_t partition) {
+        auto& partitionTuples = partitionOutputs[partition];
+        sort(partitionTuples.begin(), partitionTuples.end());
+        partitionTuples.erase(unique(partitionTuples.begin(), partitionTuples.end()), partitionTuples.end());
+    });
+
+    while (partitionOutputs.size() > 1) {
+        vector<vector<array<int, arity>>> mergedOutputs((partitionOutputs.size() + 1) / 2);
+        pool.run(mergedOutputs.size(), [&](size_t pair) {
+            if (2 * pair + 1 == partitionOutputs.size()) {
+                mergedOutputs[pair] = move(partitionOutputs[2 * pair]);
+                return;
+            }
+            const auto& tuples1 = partitionOutputs[2 * pair];
+            const auto& tuples2 = partitionOutputs[2 * pair + 1];
+            auto& merged = mergedOutputs[pair];
+            merged.reserve(tuples1.size() + tuples2.size());
+            merge(tuples1.begin(), tuples1.end(), tuples2.begin(), tuples2.end(), back_inserter(merged));
+            merged.erase(unique(merged.begin(), merged.end()), merged.end());
+            vector<array<int, arity>>().swap(partitionOutputs[2 * pair]);
+            vector<array<int, arity>>().swap(partitionOutputs[2 * pair + 1]);
+        });
+        partitionOutputs = move(mergedOutputs);
+    }
+
+    auto outputRelation = relation<arity>();
+    if (!partitionOutputs.empty())
+        tuples = move(partitionOutputs[0]);
+    if (storageMode == TREE_STORAGE) {
+        // Building a set from sorted tuples takes linear time
+        outputRelation.setDataBuffer(tupleSet<arity>(tuples.begin(), tuples.end(), queryMemoryResource()));
+    }
+    else {
+        outputRelation.setSortedFlatBuffer(move(tuples));
+    }
+    return outputRelation;
+}
+
+/*
+ * Parallel versions of selection, projection, crossProduct and equiJoinHash.
+ * They take the same parameters plus the thread pool to run on, and return exactly the same relation as the
+ * serial operators (in the storage mode of the first input relation, FLAT_STORAGE for a mapped input, or
+ * BAG_STORAGE for a cross product or join with a bag).
+ * The (first) input relation is split into partitions that are processed on the thread pool, and the
+ * per-partition outputs are merged with deduplication by mergePartitionOutputs.
+ *
+ *  For example:
+ *      threadPool pool(16);
+ *      auto rel3Arity = parallelSelection<3>(rel3Arity, 0, EQUAL, 100, pool) - the same as selection<3>(rel3Arity, 0, EQUAL, 100)
+ *                                                  using 16 threads
+ *
+ *  Note:
+ *          parallelEquiJoinHash builds the hash table on the smaller relation with one thread, and probes it with
+ *          the partitions of the other relation in parallel (the hash table is only read while probing)
+ */
+template<size_t arity>
+static relation<arity> parallelSelection(const relation<arity>& inputRelation, int attributeIndex, int operation, int operand, threadPool& pool) {
+    profileScope profile("parallelSelection");
+    profile.addInput(inputRelation);
+    predicate condition = {attributeIndex, operation, operand};
+    checkSelectionPredicates<arity>(&condition, 1, CONJUNCTION);
+
+    // Every partition is scanned with the selection kernels, like the serial selection
+    auto partitionOutputs = runPartitioned<arity>(inputRelation, pool, [&](auto first, auto last, vector<array<int, arity>>& output) {
+        if constexpr (is_pointer<decltype(first)>::value) {
+            selectContiguousTuples<arity>(first, last - first, &condition, 1, CONJUNCTION,
+                [&](const array<int, arity>& tuple) {output.push_back(tuple);});
+        }
+        else {
+            for (; first != last; ++first)
+                if (predicatesHold(first->data(), &condition, 1, CONJUNCTION))
+                    output.push_back(*first);
+        }
+    });
+    // The partitions are consecutive slices of the input, so the outputs of a sorted input are sorted and in order
+    return profile.finish(mergePartitionOutputs<arity>(move(partitionOutputs), inputRelation.getStorageMode(), pool, inputRelation.isSorted()));
+}
+
+template<size_t inputArity, size_t outputArity>
+static relation<outputArity> parallelProjection(const relation<inputArity>& inputRelation, int* indicesOfAttributesToKeepArray, threadPool& pool) {
+    profileScope profile("parallelProjection");
+    profile.addInput(inputRelation);
+    if (inputArity < outputArity) {
+        cout << "You are trying to keep more columns than what exists in the relation" << endl;
+        exit(1);
+    }
+
+    auto partitionOutputs = runPartitioned<outputArity>(inputRelation, pool, [&](auto first, auto last, vector<array<int, outputArity>>& output) {
+        for (; first != last; ++first) {
+            array<int, outputArity> projectedTuple;
+            for (size_t i = 0; i < outputArity; ++i)
+                projectedTuple[i] = (*first)[indicesOfAttributesToKeepArray[i]];
+            output.push_back(projectedTuple);
+        }
+    });
+    return profile.finish(mergePartitionOutputs<outputArity>(move(partitionOutputs), inputRelation.getStorageMode(), pool));
+}
+
+template <size_t inputArity1, size_t inputArity2>
+static relation<inputArity1 + inputArity2> parallelCrossProduct(const relation<inputArity1>& inputRelation1, const relation<inputArity2>& inputRelation2, threadPool& pool) {
+    profileScope profile("parallelCrossProduct");
+    profile.addInput(inputRelation1);
+    profile.addInput(inputRelation2);
+    auto partitionOutputs = runPartitioned<inputArity1 + inputArity2>(inputRelation1, pool,
+        [&](auto first, auto last, vector<array<int, inputArity1 + inputArity2>>& output) {
+            for (; first != last; ++first)
+                inputRelation2.forEachTuple([&](const array<int, inputArity2>& tuple2) {
+                    output.push_back(concatenateTuples<inputArity1, inputArity2>(*first, tuple2));
+                });
+        });
+    return profile.finish(mergePartitionOutputs<inputArity1 + inputArity2>(move(partitionOutputs), joinOutputStorageMode(inputRelation1, inputRelation2), pool));
+}
+
+template <size_t inputArity1, size_t inputArity2>
+static relation<inputArity1 + inputArity2> parallelEquiJoinHash(const relation<inputArity1>& inputRelation1, const relation<inputArity2>& inputRelation2,
+    int joinColumnIndexLength, int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray, threadPool& pool) {
+    profileScope profile("parallelEquiJoinHash");
+    profile.addInput(inputRelation1);
+    profile.addInput(inputRelation2);
+    constexpr size_t keyArity = inputArity1 < inputArity2 ? inputArity1 : inputArity2;
+    if (joinColumnIndexLength < 0 || joinColumnIndexLength > (int)keyArity) {
+        cout << "You are trying to join on more columns than what exists in the relations" << endl;
+        exit(1);
+    }
+
+    vector<vector<array<int, inputArity1 + inputArity2>>> partitionOutputs;
+    if (inputRelation1.getTupleCount() <= inputRelation2.getTupleCount()) {
+        auto hashTable = buildJoinHashTable<keyArity>(inputRelation1, joinColumnIndexLength, relation1JoinColumnIndexArray);
+        partitionOutputs = runPartitioned<inputArity1 + inputArity2>(inputRelation2, pool,
+            [&](auto first, auto last, vector<array<int, inputArity1 + inputArity2>>& output) {
+                for (; first != last; ++first) {
+                    auto bucket = hashTable.find(extractJoinKey<keyArity>(*first, joinColumnIndexLength, relation2JoinColumnIndexArray));
+                    if (bucket == hashTable.end())
+                        continue;
+                    for (const auto* tuple1 : bucket->second)
+                        output.push_back(concatenateTuples<inputArity1, inputArity2>(*tuple1, *first));
+                }
+            });
+    }
+    else {
+        auto hashTable = buildJoinHashTable<keyArity>(inputRelation2, joinColumnIndexLength, relation2JoinColumnIndexArray);
+        partitionOutputs = runPartitioned<inputArity1 + inputArity2>(inputRelation1, pool,
+            [&](auto first, auto last, vector<array<int, inputArity1 + inputArity2>>& output) {
+                for (; first != last; ++first) {
+                    auto bucket = hashTable.find(extractJoinKey<keyArity>(*first, joinColumnIndexLength, relation1JoinColumnIndexArray));
+                    if (bucket == hashTable.end())
+                        continue;
+                    for (const auto* tuple2 : bucket->second)
+                        output.push_back(concatenateTuples<inputArity1, inputArity2>(*first, *tuple2));
+                }
+            });
+    }
+    return profile.finish(mergePartitionOutputs<inputArity1 + inputArity2>(move(partitionOutputs), joinOutputStorageMode(inputRelation1, inputRelation2), pool));
+}
+
+
+
+/*
+ * Pipelined query plans
+ *
+ * The operators above each build their complete output relation before the next operator starts. A query plan
+ * instead chains tupleStream operators, and every operator pulls the tuples of its input one at a time with next(),
+ * so a selection feeding a projection feeding a join never stores the output of the selection or of the projection.
+ * Tuples are only stored by the pipeline breakers:
+ *  - the second (build) input of planEquiJoin and the second input of planCrossProduct, which are read completely
+ *    when the first tuple is requested, so the smaller input should be given second,
+ *  - planDistinct, which remembers every tuple it has returned,
+ *  - executePlan, which collects the result into a relation.
+ * Streams have bag semantics (e.g. a projection can return the same tuple twice), duplicates are only removed by
+ * planDistinct and executePlan, so executePlan returns the same relation as running the operators one by one.
+ *
+ * A plan is owned by its last operator (streamPointer = unique_ptr). planScan only refers to its relation, which
+ * has to outlive the plan.
+ *
+ *  For example:
+ *      int keep[2] = {0, 2};
+ *      int joinIndex1[1] = {1};
+ *      int joinIndex2[1] = {0};
+ *      auto plan = planEquiJoin<2, 3>(
+ *          planProjection<3, 2>(planSelection<3>(planScan(rel3Arity), 1, GREATERTHAN, 500), keep),
+ *          planScan(rel3ArityB), 1, joinIndex1, joinIndex2);
+ *      auto rel5Arity = executePlan<5>(move(plan));
+ *                                                  is the same as equiJoinHash<2, 3>(projection<3, 2>(selection<3>(
+ *                                                  rel3Arity, 1, GREATERTHAN, 500), keep), rel3ArityB, 1, joinIndex1, joinIndex2)
+ *                                                  without building the selection and projection outputs
+ */
+template <size_t arity>
+class tupleStream
+{
+public:
+    virtual ~tupleStream() {}
+    // Stores the next tuple in tuple and returns true, or returns false when the stream is exhausted
+    virtual bool next(array<int, arity>& tuple) = 0;
+};
+
+template <size_t arity>
+using streamPointer = unique_ptr<tupleStream<arity>>;
+
+template <size_t arity>
+class scanStream : public tupleStream<arity>
+{
+private:
+    typename tupleSet<arity>::const_iterator treePosition, treeEnd;
+    const array<int, arity>* position;
+    const array<int, arity>* end;
+    bool isTree;
+
+    void setRange(typename tupleSet<arity>::const_iterator first, typename tupleSet<arity>::const_iterator last) {
+        treePosition = first;
+        treeEnd = last;
+        isTree = true;
+    }
+    void setRange(const array<int, arity>* first, const array<int, arity>* last) {
+        position = first;
+        end = last;
+        isTree = false;
+    }
+
+public:
+    scanStream(const relation<arity>& inputRelation) {
+        inputRelation.visitTupleRange([this](auto first, auto last) {setRange(first, last);});
+    }
+
+    bool next(array<int, arity>& tuple) override {
+        if (isTree) {
+            if (treePosition == treeEnd)
+                return false;
+            tuple = *treePosition++;
+            return true;
+        }
+        if (position == end)
+            return false;
+        tuple = *position++;
+        return true;
+    }
+};
+
+template <size_t arity>
+class selectionStream : public tupleStream<arity>
+{
+private:
+    streamPointer<arity> input;
+    vector<predicate> predicates;
+    int combination;
+
+public:
+    selectionStream(streamPointer<arity> input, vector<predicate> predicates, int combination)
+        : input(move(input)), predicates(move(predicates)), combination(combination) {}
+
+    bool next(array<int, arity>& tuple) override {
+        while (input->next(tuple))
+            if (predicatesHold(tuple.data(), predicates.data(), predicates.size(), combination))
+                return true;
+        return false;
+    }
+};
+
+template <size_t inputArity, size_t outputArity>
+class projectionStream : public tupleStream<outputArity>
+{
+private:
+    streamPointer<inputArity> input;
+    array<int, outputArity> indicesOfAttributesToKeep;
+
+public:
+    projectionStream(streamPointer<inputArity> input, const int* indicesOfAttributesToKeepArray) : input(move(input)) {
+        copy(indicesOfAttributesToKeepArray, indicesOfAttributesToKeepArray + outputArity, indicesOfAttributesToKeep.begin());
+    }
+
+    bool next(array<int, outputArity>& tuple) override {
+        array<int, inputArity> inputTuple;
+        if (!input->next(inputTuple))
+            return false;
+        for (size_t i = 0; i < outputArity; ++i)
+            tuple[i] = inputTuple[indicesOfAttributesToKeep[i]];
+        return true;
+    }
+};
+
+template <size_t inputArity1, size_t inputArity2>
+class crossProductStream : public tupleStream<inputArity1 + inputArity2>
+{
+private:
+    streamPointer<inputArity1> input1;
+    streamPointer<inputArity2> input2;
+    vector<array<int, inputArity2>> tuples2;
+    array<int, inputArity1> tuple1;
+    size_t position2;
+    bool started;
+
+public:
+    crossProductStream(streamPointer<inputArity1> input1, streamPointer<inputArity2> input2)
+        : input1(move(input1)), input2(move(input2)), position2(0), started(false) {}
+
+    bool next(array<int, inputArity1 + inputArity2>& tuple) override {
+        if (!started) {
+            array<int, inputArity2> tuple2;
+            while (input2->next(tuple2))
+                tuples2.push_back(tuple2);
+            started = true;
+            position2 = tuples2.size();
+        }
+        if (tuples2.empty())
+            return false;
+        if (position2 == tuples2.size()) {
+            if (!input1->next(tuple1))
+                return false;
+            position2 = 0;
+        }
+        tuple = concatenateTuples<inputArity1, inputArity2>(tuple1, tuples2[position2++]);
+        return true;
+    }
+};
+
+template <size_t inputArity1, size_t inputArity2>
+class equiJoinStream : public tupleStream<inputArity1 + inputArity2>
+{
+private:
+    static constexpr size_t keyArity = inputArity1 < inputArity2 ? inputArity1 : inputArity2;
+
+    streamPointer<inputArity1> input1;
+    streamPointer<inputArity2> input2;
+    int joinColumnIndexLength;
+    vector<int> relation1JoinColumnIndexes;
+    vector<int> relation2JoinColumnIndexes;
+    vector<array<int, inputArity2>> tuples2;
+    unordered_map<array<int, keyArity>, vector<size_t>, joinKeyHash<keyArity>> hashTable;
+    array<int, inputArity1> tuple1;
+    const vector<size_t>* matches;
+    size_t matchPosition;
+    bool started;
+
+public:
+    equiJoinStream(streamPointer<inputArity1> input1, streamPointer<inputArity2> input2,
+        int joinColumnIndexLength, const int* relation1JoinColumnIndexArray, const int* relation2JoinColumnIndexArray)
+        : input1(move(input1)), input2(move(input2)), joinColumnIndexLength(joinColumnIndexLength),
+          relation1JoinColumnIndexes(relation1JoinColumnIndexArray, relation1JoinColumnIndexArray + joinColumnIndexLength),
+          relation2JoinColumnIndexes(relation2JoinColumnIndexArray, relation2JoinColumnIndexArray + joinColumnIndexLength),
+          matches(NULL), matchPosition(0), started(false) {}
+
+    bool next(array<int, inputArity1 + inputArity2>& tuple) override {
+        if (!started) {
+            // Build the hash table on the second input
+            array<int, inputArity2> tuple2;
+            while (input2->next(tuple2)) {
+                hashTable[extractJoinKey<keyArity>(tuple2, joinColumnIndexLength, relation2JoinColumnIndexes.data())].push_back(tuples2.size());
+                tuples2.push_back(tuple2);
+            }
+            started = true;
+        }
+        while (matches == NULL || matchPosition == matches->size()) {
+            if (!input1->next(tuple1))
+                return false;
+            auto bucket = hashTable.find(extractJoinKey<keyArity>(tuple1, joinColumnIndexLength, relation1JoinColumnIndexes.data()));
+            matches = (bucket == hashTable.end()) ? NULL : &bucket->second;
+            matchPosition = 0;
+        }
+        tuple = concatenateTuples<inputArity1, inputArity2>(tuple1, tuples2[(*matches)[matchPosition++]]);
+        return true;
+    }
+};
+
+template <size_t arity>
+class distinctStream : public tupleStream<arity>
+{
+private:
+    streamPointer<arity> input;
+    unordered_set<array<int, arity>, joinKeyHash<arity>> returnedTuples;
+
+public:
+    distinctStream(streamPointer<arity> input) : input(move(input)) {}
+
+    bool next(array<int, arity>& tuple) override {
+        while (input->next(tuple))
+            if (returnedTuples.insert(tuple).second)
+                return true;
+        return false;
+    }
+};
+
+template <size_t arity>
+static streamPointer<arity> planScan(const relation<arity>& inputRelation) {
+    return make_unique<scanStream<arity>>(inputRelation);
+}
+
+template <size_t arity>
+static streamPointer<arity> planSelection(streamPointer<arity> input, int attributeIndex, int operation, int operand) {
+    predicate condition = {attributeIndex, operation, operand};
+    checkSelectionPredicates<arity>(&condition, 1, CONJUNCTION);
+    return make_unique<selectionStream<arity>>(move(input), vector<predicate>{{attributeIndex, operation, operand}}, CONJUNCTION);
+}
+
+template <size_t arity>
+static streamPointer<arity> planSelection(streamPointer<arity> input, const predicate* predicates, int predicateCount, int combination) {
+    // The same checks as selection, so that an invalid predicate is an error instead of dropping every tuple
+    checkSelectionPredicates<arity>(predicates, predicateCount, combination);
+    return make_unique<selectionStream<arity>>(move(input), vector<predicate>(predicates, predicates + predicateCount), combination);
+}
+
+template <size_t inputArity, size_t outputArity>
+static streamPointer<outputArity> planProjection(streamPointer<inputArity> input, const int* indicesOfAttributesToKeepArray) {
+    if (inputArity < outputArity) {
+        cout << "You are trying to keep more columns than what exists in the relation" << endl;
+        exit(1);
+    }
+    return make_unique<projectionStream<inputArity, outputArity>>(move(input), indicesOfAttributesToKeepArray);
+}
+
+template <size_t inputArity1, size_t inputArity2>
+static streamPointer<inputArity1 + inputArity2> planCrossProduct(streamPointer<inputArity1> input1, streamPointer<inputArity2> input2) {
+    return make_unique<crossProductStream<inputArity1, inputArity2>>(move(input1), move(input2));
+}
+
+template <size_t inputArity1, size_t inputArity2>
+static streamPointer<inputArity1 + inputArity2> planEquiJoin(streamPointer<inputArity1> input1, streamPointer<inputArity2> input2,
+    int joinColumnIndexLength, const int* relation1JoinColumnIndexArray, const int* relation2JoinColumnIndexArray) {
+    if (joinColumnIndexLength < 0 || joinColumnIndexLength > (int)inputArity1 || joinColumnIndexLength > (int)inputArity2) {
+        cout << "You are trying to join on more columns than what exists in the relations" << endl;
+        exit(1);
+    }
+    return make_unique<equiJoinStream<inputArity1, inputArity2>>(move(input1), move(input2),
+        joinColumnIndexLength, relation1JoinColumnIndexArray, relation2JoinColumnIndexArray);
+}
+
+template <size_t arity>
+static streamPointer<arity> planDistinct(streamPointer<arity> input) {
+    return make_unique<distinctStream<arity>>(move(input));
+}
+
+// Runs the plan and collects its (deduplicated, unless storageMode is BAG_STORAGE) result into a relation
+template <size_t arity>
+static relation<arity> executePlan(streamPointer<arity> plan, int storageMode = TREE_STORAGE) {
+    relationBuilder<arity> outputRelation(storageMode);
+    array<int, arity> tuple;
+    while (plan->next(tuple))
+        outputRelation.insert(tuple);
+    return outputRelation.build();
+}
+
+
+
+/*
+ * Streaming file scans, for relations larger than memory
+ *
+ * planFileScan reads a raw binary file (as written by saveToFile) chunkTuples tuples at a time, so a plan like
+ * planSelection(planFileScan<3>("case1"), ...) never holds more than one chunk of the file. It can be the input of
+ * planSelection, planProjection and the first (probe) input of planEquiJoin; the second (build) input of a join
+ * is kept in memory, so it should be the smaller relation.
+ * The tuples of the file are returned in file order, including duplicates.
+ *
+ * executePlanToFile is the bounded-memory counterpart of executePlan: it deduplicates the result of the plan with an
+ * externalSorter, which spills sorted runs to temporary files once it holds memoryBudgetTuples tuples, and writes the
+ * sorted, deduplicated result to a raw file that can be loaded again (e.g. with MAPPED_STORAGE).
+ * The memory used is about chunkTuples + memoryBudgetTuples tuples, plus the build sides of the joins.
+ *
+ *  For example:
+ *      int keep[2] = {0, 2};
+ *      executePlanToFile<2>(planProjection<3, 2>(planSelection<3>(planFileScan<3>("case1"), 1, EQUAL, 7), keep), "out") -
+ *                                                  selection and projection of case1 without loading it
+ */
+const size_t DEFAULT_STREAM_CHUNK_TUPLES = 1 << 16;
+
+template <size_t arity>
+class fileScanStream : public tupleStream<arity>
+{
+private:
+    FILE* pFile;
+    vector<array<int, arity>> chunk;
+    size_t chunkTuples;
+    size_t position;
+
+public:
+    fileScanStream(const char* filename, size_t chunkTuples) : chunkTuples(chunkTuples > 0 ? chunkTuples : 1), position(0) {
+        errno_t err = fopen_s(&pFile, filename, "rb");
+        if (err != 0 || pFile == NULL)
+        {
+            fputs("File error", stderr);
+            exit(1);
+        }
+    }
+    ~fileScanStream() {fclose(pFile);}
+    fileScanStream(const fileScanStream&) = delete;
+    fileScanStream& operator=(const fileScanStream&) = delete;
+
+    bool next(array<int, arity>& tuple) override {
+        if (position == chunk.size()) {
+            // Trailing bytes that do not make up a whole tuple are ignored, as with MAPPED_STORAGE
+            chunk.resize(chunkTuples);
+            chunk.resize(fread(chunk.data(), sizeof(array<int, arity>), chunkTuples, pFile));
+            position = 0;
+            if (chunk.empty())
+                return false;
+        }
+        tuple = chunk[position++];
+        return true;
+    }
+};
+
+template <size_t arity>
+static streamPointer<arity> planFileScan(const char* filename, size_t chunkTuples = DEFAULT_STREAM_CHUNK_TUPLES) {
+    return make_unique<fileScanStream<arity>>(filename, chunkTuples);
+}
+
+// Runs the plan, and writes its sorted and deduplicated result to filename. Returns the number of tuples written
+template <size_t arity>
+static size_t executePlanToFile(streamPointer<arity> plan, const char* filename, size_t memoryBudgetTuples = DEFAULT_SORT_MEMORY_BUDGET) {
+    externalSorter<arity> sorter(0, NULL, memoryBudgetTuples);
+    array<int, arity> tuple;
+    while (plan->next(tuple))
+        sorter.add(tuple);
+    sorter.finish();
+
+    removeIndexFiles(filename, (int)arity);
+    FILE* pFile;
+    errno_t err = fopen_s(&pFile, filename, "wb");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    // Equal tuples come out of the sorter next to each other
+    vector<array<int, arity>> outputChunk;
+    outputChunk.reserve(DEFAULT_STREAM_CHUNK_TUPLES);
+    array<int, arity> previousTuple;
+    size_t writtenTuples = 0;
+    while (sorter.next(tuple)) {
+        if (writtenTuples > 0 && tuple == previousTuple)
+            continue;
+        previousTuple = tuple;
+        outputChunk.push_back(tuple);
+        ++writtenTuples;
+        if (outputChunk.size() == DEFAULT_STREAM_CHUNK_TUPLES) {
+            fwrite(outputChunk.data(), sizeof(array<int, arity>), outputChunk.size(), pFile);
+            outputChunk.clear();
+        }
+    }
+    if (!outputChunk.empty())
+        fwrite(outputChunk.data(), sizeof(array<int, arity>), outputChunk.size(), pFile);
+    fclose(pFile);
+    return writtenTuples;
+}
+
+
+
+/*
+ *
+ * Semi-naive fixpoint
+ * Computes the smallest relation that contains initialRelation and is closed under a recursive rule, e.g.
+ * path(x, z) :- path(x, y), edge(y, z).
+ *
+ * A naive loop joins the whole result with the rule again in every iteration, and so rederives every tuple it already
+ * has. Semi-naive evaluation only applies the rule to the delta, the tuples that were new in the previous iteration,
+ * and stops when an iteration finds no new tuple. This gives the same result for rules that use the recursive
+ * relation once (linear recursion, like the transitive closure below).
+ *
+ * Template parameters:
+ *      arity - arity of the recursive relation
+ *      DeltaRule - deltaRule(delta, emit) is called once per iteration with the vector of new tuples, and calls
+ *                  emit(tuple) for every tuple the rule derives from them. Emitting a tuple that is already known is
+ *                  fine, it is ignored. The rule should look the other relations up through an index (e.g. a
+ *                  joinHashTable) instead of scanning them, so an iteration costs O(delta + output).
+ *
+ * Function parameters:
+ *      initialRelation - the tuples the fixpoint starts from (the first delta)
+ *      deltaRule - the recursive rule
+ *      storageMode - storage mode of the output relation
+ *
+ *  For example:
+ *      auto reachable = semiNaiveFixpoint<1>(startNodes, [&](const vector<array<int, 1>>& delta, auto& emit) {
+ *          for (auto& node : delta)
+ *              for (auto* edge : edgesBySource[{node[0]}])
+ *                  emit(array<int, 1>{(*edge)[1]});
+ *      });                                         - every node reachable from startNodes
+ */
+template <size_t arity, typename DeltaRule>
+static relation<arity> semiNaiveFixpoint(const relation<arity>& initialRelation, DeltaRule deltaRule, int storageMode = TREE_STORAGE) {
+    unordered_set<array<int, arity>, joinKeyHash<arity>> knownTuples;
+    knownTuples.reserve(initialRelation.getTupleCount());
+    vector<array<int, arity>> delta, nextDelta;
+    initialRelation.forEachTuple([&](const array<int, arity>& tuple) {
+        if (knownTuples.insert(tuple).second)
+            delta.push_back(tuple);
+    });
+
+    auto emit = [&](const array<int, arity>& tuple) {
+        if (knownTuples.insert(tuple).second)
+            nextDelta.push_back(tuple);
+    };
+    while (!delta.empty()) {
+        nextDelta.clear();
+        deltaRule(static_cast<const vector<array<int, arity>>&>(delta), emit);
+        swap(delta, nextDelta);
+    }
+
+    relationBuilder<arity> outputRelation(storageMode);
+    for (const auto& tuple : knownTuples)
+        outputRelation.insert(tuple);
+    return outputRelation.build();
+}
+
+/*
+ * Transitive closure of a directed graph given as an edge relation of (source, target) tuples: (x, z) is in the output
+ * if there is a path of one or more edges from x to z. The edges are indexed on their source once, and every iteration
+ * extends only the paths found in the previous iteration by one edge.
+ *
+ *  For example:
+ *      auto rel2Arity = transitiveClosure(edges) - with edges {(1, 2), (2, 3), (3, 4)} returns
+ *                                                  {(1, 2), (1, 3), (1, 4), (2, 3), (2, 4), (3, 4)}
+ */
+static relation<2> transitiveClosure(const relation<2>& edges, int storageMode = TREE_STORAGE) {
+    int sourceColumnIndex[1] = {0};
+    auto edgesBySource = buildJoinHashTable<1>(edges, 1, sourceColumnIndex);
+    return semiNaiveFixpoint<2>(edges, [&](const vector<array<int, 2>>& delta, auto& emit) {
+        for (const auto& path : delta) {
+            auto outgoingEdges = edgesBySource.find({path[1]});
+            if (outgoingEdges == edgesBySource.end())
+                continue;
+            for (const auto* edge : outgoingEdges->second)
+                emit(array<int, 2>{path[0], (*edge)[1]});
+        }
+    }, storageMode);
+}
+
+
+
+/*
+ * Block-compressed relation files
+ *
+ * The raw format stores every tuple as arity 4-byte ints. The compressed format cuts the tuples into blocks of
+ * COMPRESSED_BLOCK_TUPLES tuples and bit-packs every column of a block, either as the difference to the smallest value
+ * of the column in the block (frame of reference) or, when that takes fewer bits, as the differences between
+ * consecutive values (delta). The first column of a sorted relation only increases, so its deltas take a few bits.
+ * Every block also records the minimum and maximum of each of its columns (a zone map): compressedSelection only
+ * reads and decodes the blocks whose zone map says they can hold a matching tuple.
+ *
+ * File layout: a compressedFileHeader, the blocks, and then the directory (one compressedBlockEntry per block) at
+ * directoryOffset. In a block, every column is a compressedColumnHeader followed by its 64-bit words.
+ * The tuples keep the order they were written in, so a sorted relation (or a raw file written by saveToFile) gives
+ * the smallest file and the fewest blocks to read.
+ *
+ *  For example:
+ *      saveCompressedFile<3>(rel3Arity, "rel3.compressed");
+ *      auto rel3Selected = compressedSelection<3>("rel3.compressed", 0, LESSTHAN, 1000) -
+ *                                                  only reads the blocks whose first column has a value less than 1000
+ *      convertCompressedToRaw<3>("rel3.compressed", "rel3.raw");
+ */
+static const int COMPRESSED_BLOCK_TUPLES = 8192;
+
+enum ColumnEncoding {
+    FRAME_OF_REFERENCE,
+    DELTA_ENCODING
+};
+
+struct compressedFileHeader
+{
+    char magic[4];              // "RACF"
+    int32_t arity;
+    int32_t blockTupleCount;
+    int32_t blockCount;
+    int32_t sorted;             // 1 if the tuples were written in increasing order without duplicates
+    int64_t tupleCount;
+    int64_t directoryOffset;
+};
+
+struct compressedColumnHeader
+{
+    int32_t encoding;
+    int32_t bitWidth;
+    int64_t reference;          // FRAME_OF_REFERENCE: the minimum, DELTA_ENCODING: the first value
+    int64_t minimumDelta;       // DELTA_ENCODING only, the packed values are delta - minimumDelta
+};
+
+template <size_t arity>
+struct compressedBlockEntry
+{
+    int64_t offset;
+    int32_t tupleCount;
+    int32_t byteCount;
+    array<int, arity> minimum;
+    array<int, arity> maximum;
+};
+
+static int bitWidthOf(uint64_t value) {
+    int bitWidth = 0;
+    for (; value != 0; value >>= 1)
+        ++bitWidth;
+    return bitWidth;
+}
+
+// Appends the low bitWidth bits of every value to words
+static void packBits(const vector<uint64_t>& values, int bitWidth, vector<uint64_t>& words) {
+    if (bitWidth == 0)
+        return;
+    size_t firstWord = words.size();
+    words.resize(firstWord + (values.size() * bitWidth + 63) / 64, 0);
+    uint64_t* packedWords = words.data() + firstWord;
+    for (size_t i = 0; i < values.size(); ++i) {
+        size_t bitPosition = i * bitWidth;
+        int shift = bitPosition & 63;
+        packedWords[bitPosition >> 6] |= values[i] << shift;
+        if (shift + bitWidth > 64)
+            packedWords[(bitPosition >> 6) + 1] |= values[i] >> (64 - shift);
+    }
+}
+
+static uint64_t unpackBits(const uint64_t* words, size_t i, int bitWidth) {
+    if (bitWidth == 0)
+        return 0;
+    size_t bitPosition = i * bitWidth;
+    int shift = bitPosition & 63;
+    uint64_t value = words[bitPosition >> 6] >> shift;
+    if (shift + bitWidth > 64)
+        value |= words[(bitPosition >> 6) + 1] << (64 - shift);
+    return value & ((uint64_t(1) << bitWidth) - 1);
+}
+
+// Encodes tupleCount tuples into words (column headers and packed columns), and fills the zone map of entry
+template <size_t arity>
+static void encodeCompressedBlock(const array<int, arity>* tuples, size_t tupleCount, vector<uint64_t>& words, compressedBlockEntry<arity>& entry) {
+    static_assert(sizeof(compressedColumnHeader) % sizeof(uint64_t) == 0, "column headers must keep the words aligned");
+    vector<uint64_t> values(tupleCount);
+    for (size_t column = 0; column < arity; ++column) {
+        int64_t minimum = tuples[0][column], maximum = tuples[0][column];
+        int64_t minimumDelta = 0, maximumDelta = 0;
+        for (size_t i = 1; i < tupleCount; ++i) {
+            int64_t value = tuples[i][column];
+            int64_t delta = value - tuples[i - 1][column];
+            minimum = min(minimum, value);
+            maximum = max(maximum, value);
+            minimumDelta = (i == 1) ? delta : min(minimumDelta, delta);
+            maximumDelta = (i == 1) ? delta : max(maximumDelta, delta);
+        }
+        entry.minimum[column] = (int)minimum;
+        entry.maximum[column] = (int)maximum;
+
+        compressedColumnHeader columnHeader;
+        memset(&columnHeader, 0, sizeof(columnHeader));
+        int deltaBitWidth = bitWidthOf(maximumDelta - minimumDelta);
+        columnHeader.bitWidth = bitWidthOf(maximum - minimum);
+        if (deltaBitWidth < columnHeader.bitWidth) {
+            columnHeader.encoding = DELTA_ENCODING;
+            columnHeader.bitWidth = deltaBitWidth;
+            columnHeader.reference = tuples[0][column];
+            columnHeader.minimumDelta = minimumDelta;
+            values.resize(tupleCount - 1);
+            for (size_t i = 1; i < tupleCount; ++i)
+                values[i - 1] = (int64_t)tuples[i][column] - tuples[i - 1][column] - minimumDelta;
+        }
+        else {
+            columnHeader.encoding = FRAME_OF_REFERENCE;
+            columnHeader.reference = minimum;
+            columnHeader.minimumDelta = 0;
+            values.resize(tupleCount);
+            for (size_t i = 0; i < tupleCount; ++i)
+                values[i] = tuples[i][column] - minimum;
+        }
+
+        size_t headerWord = words.size();
+        words.resize(headerWord + sizeof(compressedColumnHeader) / sizeof(uint64_t));
+        memcpy(&words[headerWord], &columnHeader, sizeof(compressedColumnHeader));
+        packBits(values, columnHeader.bitWidth, words);
+    }
+}
+
+template <size_t arity>
+static void decodeCompressedBlock(const uint64_t* words, size_t tupleCount, array<int, arity>* tuples) {
+    for (size_t column = 0; column < arity; ++column) {
+        compressedColumnHeader columnHeader;
+        memcpy(&columnHeader, words, sizeof(compressedColumnHeader));
+        words += sizeof(compressedColumnHeader) / sizeof(uint64_t);
+        if (columnHeader.encoding == DELTA_ENCODING) {
+            int64_t value = columnHeader.reference;
+            tuples[0][column] = (int)value;
+            for (size_t i = 1; i < tupleCount; ++i) {
+                value += columnHeader.minimumDelta + (int64_t)unpackBits(words, i - 1, columnHeader.bitWidth);
+                tuples[i][column] = (int)value;
+            }
+            words += ((tupleCount - 1) * columnHeader.bitWidth + 63) / 64;
+        }
+        else {
+            for (size_t i = 0; i < tupleCount; ++i)
+                tuples[i][column] = (int)(columnHeader.reference + (int64_t)unpackBits(words, i, columnHeader.bitWidth));
+            words += (tupleCount * columnHeader.bitWidth + 63) / 64;
+        }
+    }
+}
+
+/*
+ * Writes a compressed file tuple by tuple (add), keeping only one block in memory. finish writes the last block and
+ * the directory; it is called by the destructor if it was not called before.
+ */
+template <size_t arity>
+class compressedFileWriter
+{
+private:
+    FILE* pFile;
+    compressedFileHeader header;
+    vector<compressedBlockEntry<arity>> directory;
+    vector<array<int, arity>> blockTuples;
+    vector<uint64_t> blockWords;
+    array<int, arity> lastTuple;
+    int64_t fileOffset;
+
+    void writeBlock();
+
+public:
+    compressedFileWriter(const char* filename);
+    ~compressedFileWriter() {finish();}
+    compressedFileWriter(const compressedFileWriter&) = delete;
+    compressedFileWriter& operator=(const compressedFileWriter&) = delete;
+
+    void add(const array<int, arity>& tuple) {
+        if (header.tupleCount > 0 && !(lastTuple < tuple))
+            header.sorted = 0;
+        lastTuple = tuple;
+        blockTuples.push_back(tuple);
+        ++header.tupleCount;
+        if (blockTuples.size() == (size_t)COMPRESSED_BLOCK_TUPLES)
+            writeBlock();
+    }
+    void finish();
+};
+
+template <size_t arity>
+compressedFileWriter<arity>::compressedFileWriter(const char* filename)
+{
+    errno_t err = fopen_s(&pFile, filename, "wb");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    // The headers are written with memcpy-like fwrites, so their padding is zeroed rather than left uninitialized
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "RACF", 4);
+    header.arity = arity;
+    header.blockTupleCount = COMPRESSED_BLOCK_TUPLES;
+    header.blockCount = 0;
+    header.sorted = 1;
+    header.tupleCount = 0;
+    header.directoryOffset = 0;
+    // The header is written again by finish, once the directory offset is known
+    if (fwrite(&header, sizeof(header), 1, pFile) != 1)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    fileOffset = sizeof(header);
+    blockTuples.reserve(COMPRESSED_BLOCK_TUPLES);
+}
+
+template <size_t arity>
+void compressedFileWriter<arity>::writeBlock()
+{
+    compressedBlockEntry<arity> entry;
+    memset(&entry, 0, sizeof(entry));
+    blockWords.clear();
+    encodeCompressedBlock<arity>(blockTuples.data(), blockTuples.size(), blockWords, entry);
+    entry.offset = fileOffset;
+    entry.tupleCount = blockTuples.size();
+    entry.byteCount = blockWords.size() * sizeof(uint64_t);
+    if (fwrite(blockWords.data(), sizeof(uint64_t), blockWords.size(), pFile) != blockWords.size())
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    fileOffset += entry.byteCount;
+    directory.push_back(entry);
+    blockTuples.clear();
+}
+
+template <size_t arity>
+void compressedFileWriter<arity>::finish()
+{
+    if (pFile == NULL)
+        return;
+    if (!blockTuples.empty())
+        writeBlock();
+    header.blockCount = directory.size();
+    header.directoryOffset = fileOffset;
+    bool written = (directory.empty() || fwrite(directory.data(), sizeof(compressedBlockEntry<arity>), directory.size(), pFile) == directory.size())
+        && fseek(pFile, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, pFile) == 1;
+    written = (fclose(pFile) == 0) && written;
+    pFile = NULL;
+    if (!written)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+}
+
+/*
+ * Reads the header and the directory of a compressed file, and then any block on request.
+ * getBytesRead() counts the bytes of the blocks read so far.
+ */
+template <size_t arity>
+class compressedFileReader
+{
+private:
+    FILE* pFile;
+    compressedFileHeader header;
+    vector<compressedBlockEntry<arity>> directory;
+    vector<uint64_t> blockWords;
+    size_t bytesRead;
+
+public:
+    compressedFileReader(const char* filename);
+    ~compressedFileReader() {fclose(pFile);}
+    compressedFileReader(const compressedFileReader&) = delete;
+    compressedFileReader& operator=(const compressedFileReader&) = delete;
+
+    int getBlockCount() const {return header.blockCount;}
+    int64_t getTupleCount() const {return header.tupleCount;}
+    bool isSorted() const {return header.sorted == 1;}
+    size_t getBytesRead() const {return bytesRead;}
+    const compressedBlockEntry<arity>& getBlock(int block) const {return directory[block];}
+    // False if the zone map of the block shows that none of its tuples can satisfy the predicates
+    bool blockMayMatch(int block, const predicate* predicates, int predicateCount, int combination) const;
+    // Reads and decodes a block into tuples (resized to the tuple count of the block)
+    void readBlock(int block, vector<array<int, arity>>& tuples);
+};
+
+template <size_t arity>
+compressedFileReader<arity>::compressedFileReader(const char* filename)
+{
+    bytesRead = 0;
+    errno_t err = fopen_s(&pFile, filename, "rb");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    if (fread(&header, sizeof(header), 1, pFile) != 1 || memcmp(header.magic, "RACF", 4) != 0)
+    {
+        cout << "Not a compressed relation file" << endl;
+        exit(1);
+    }
+    if (header.arity != (int32_t)arity)
+    {
+        cout << "The compressed file holds a relation of arity " << header.arity << endl;
+        exit(1);
+    }
+    directory.resize(header.blockCount);
+    seekFile(pFile, header.directoryOffset);
+    if (!directory.empty() && fread(directory.data(), sizeof(compressedBlockEntry<arity>), directory.size(), pFile) != directory.size())
+    {
+        cout << "File reading error" << endl;
+        exit(1);
+    }
+}
+
+template <size_t arity>
+bool compressedFileReader<arity>::blockMayMatch(int block, const predicate* predicates, int predicateCount, int combination) const
+{
+    const compressedBlockEntry<arity>& entry = directory[block];
+    for (int i = 0; i < predicateCount; ++i) {
+        int minimum = entry.minimum[predicates[i].attributeIndex];
+        int maximum = entry.maximum[predicates[i].attributeIndex];
+        int operand = predicates[i].operand;
+        bool mayMatch = (predicates[i].operation == EQUAL) ? (minimum <= operand && operand <= maximum)
+                      : (predicates[i].operation == LESSTHAN) ? (minimum < operand)
+                      : (maximum > operand);
+        if (combination == CONJUNCTION && !mayMatch)
+            return false;
+        if (combination == DISJUNCTION && mayMatch)
+            return true;
+    }
+    return combination == CONJUNCTION;
+}
+
+template <size_t arity>
+void compressedFileReader<arity>::readBlock(int block, vector<array<int, arity>>& tuples)
+{
+    const compressedBlockEntry<arity>& entry = directory[block];
+    blockWords.resize(entry.byteCount / sizeof(uint64_t));
+    seekFile(pFile, entry.offset);
+    if (fread(blockWords.data(), sizeof(uint64_t), blockWords.size(), pFile) != blockWords.size())
+    {
+        cout << "File reading error" << endl;
+        exit(1);
+    }
+    bytesRead += entry.byteCount;
+    tuples.resize(entry.tupleCount);
+    decodeCompressedBlock<arity>(blockWords.data(), entry.tupleCount, tuples.data());
+}
+
+// Writes the relation as a compressed file
+template <size_t arity>
+static void saveCompressedFile(const relation<arity>& inputRelation, const char* filename) {
+    compressedFileWriter<arity> writer(filename);
+    inputRelation.forEachTuple([&](const array<int, arity>& tuple) {writer.add(tuple);});
+    writer.finish();
+}
+
+// Loads a compressed file into a relation (MAPPED_STORAGE gives a FLAT_STORAGE relation)
+template <size_t arity>
+static relation<arity> loadCompressedFile(const char* filename, int storageMode = TREE_STORAGE) {
+    profileScope profile("loadCompressedFile");
+    compressedFileReader<arity> reader(filename);
+    relationBuilder<arity> outputRelation(storageMode, reader.isSorted());
+    vector<array<int, arity>> tuples;
+    for (int block = 0; block < reader.getBlockCount(); ++block) {
+        reader.readBlock(block, tuples);
+        for (const auto& tuple : tuples)
+            outputRelation.insert(tuple);
+    }
+    profile.addBytesRead(reader.getBytesRead());
+    return profile.finish(outputRelation.build());
+}
+
+// Converts a raw file (as written by saveToFile) to a compressed file, one block at a time
+template <size_t arity>
+static void convertRawToCompressed(const char* rawFilename, const char* compressedFilename) {
+    FILE* pFile;
+    errno_t err = fopen_s(&pFile, rawFilename, "rb");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    compressedFileWriter<arity> writer(compressedFilename);
+    vector<array<int, arity>> tuples(COMPRESSED_BLOCK_TUPLES);
+    size_t readCount;
+    while ((readCount = fread(tuples.data(), sizeof(array<int, arity>), tuples.size(), pFile)) > 0) {
+        for (size_t i = 0; i < readCount; ++i)
+            writer.add(tuples[i]);
+    }
+    fclose(pFile);
+    writer.finish();
+}
+
+// Converts a compressed file back to a raw file with the tuples in the same order, one block at a time
+template <size_t arity>
+static void convertCompressedToRaw(const char* compressedFilename, const char* rawFilename) {
+    compressedFileReader<arity> reader(compressedFilename);
+    removeIndexFiles(rawFilename, (int)arity);
+    FILE* pFile;
+    errno_t err = fopen_s(&pFile, rawFilename, "wb");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    vector<array<int, arity>> tuples;
+    for (int block = 0; block < reader.getBlockCount(); ++block) {
+        reader.readBlock(block, tuples);
+        if (fwrite(tuples.data(), sizeof(array<int, arity>), tuples.size(), pFile) != tuples.size())
+        {
+            fputs("File error", stderr);
+            exit(1);
+        }
+    }
+    fclose(pFile);
+}
+
+/*
+ * Selection on a compressed file, with the same predicates as selection. Blocks whose zone map rules out every
+ * tuple are neither read nor decoded, the others are decoded and scanned with the selection kernels.
+ * If bytesRead is not NULL it is set to the number of block bytes read.
+ */
+template <size_t arity>
+static relation<arity> compressedSelection(const char* filename, const predicate* predicates, int predicateCount, int combination,
+    int storageMode = TREE_STORAGE, size_t* bytesRead = NULL) {
+    profileScope profile("compressedSelection");
+    checkSelectionPredicates<arity>(predicates, predicateCount, combination);
+
+    compressedFileReader<arity> reader(filename);
+    relationBuilder<arity> outputRelation(storageMode, reader.isSorted());
+    vector<array<int, arity>> tuples;
+    for (int block = 0; block < reader.getBlockCount(); ++block) {
+        if (!reader.blockMayMatch(block, predicates, predicateCount, combination))
+            continue;
+        reader.readBlock(block, tuples);
+        selectContiguousTuples<arity>(tuples.data(), tuples.size(), predicates, predicateCount, combination,
+            [&](const array<int, arity>& tuple) {outputRelation.insert(tuple);});
+    }
+    if (bytesRead != NULL)
+        *bytesRead = reader.getBytesRead();
+    profile.addBytesRead(reader.getBytesRead());
+    return profile.finish(outputRelation.build());
+}
+
+template <size_t arity>
+static relation<arity> compressedSelection(const char* filename, int attributeIndex, int operation, int operand, int storageMode = TREE_STORAGE) {
+    predicate condition = {attributeIndex, operation, operand};
+    return compressedSelection<arity>(filename, &condition, 1, CONJUNCTION, storageMode);
+}
+
+
+
+/*
+ * Runtime-arity relations
+ *
+ * relation<arity> and its operators need every arity at compile time, so every new query shape is another template
+ * instantiation. A dynamicRelation has its arity as a runtime value and keeps its tuples in one flat row-major
+ * buffer, sorted and deduplicated like FLAT_STORAGE: tuple i is getData()[i * arity] .. getData()[i * arity + arity - 1].
+ * The same file format is used, so the same file can be loaded as either kind of relation.
+ *
+ * The operators selection, projection, crossProduct and equiJoinHash are overloaded for dynamicRelation and are called
+ * without template arguments. Selection uses the same vectorized kernels as FLAT_STORAGE (they already take the arity
+ * at runtime), and sorting uses the relation<arity> tuple type for arities up to 8, so the templates stay the fast
+ * path and are only replaced by a generic row comparison for wider tuples.
+ * toDynamicRelation and toStaticRelation convert between the two.
+ *
+ *  For example:
+ *      dynamicRelation rel3Arity("case1", 3);
+ *      int indicesOfAttributesToKeepArray[2] = {0, 2};
+ *      auto rel2Arity = projection(selection(rel3Arity, 1, GREATERTHAN, 500), indicesOfAttributesToKeepArray, 2);
+ */
+class dynamicRelation
+{
+private:
+    int arity;
+    vector<int> data;
+
+    void checkDataSize(const vector<int>& data) const;
+
+public:
+    explicit dynamicRelation(int arity = 1);
+    dynamicRelation(const char *filename, int arity);
+
+    void loadFromFile(const char *filename);
+    void saveToFile(const char *filename) const;
+    void printRelation() const;
+
+    int getArity() const {return arity;}
+    int getTupleCount() const {return data.size() / arity;}
+    const int* getTuple(int i) const {return data.data() + (size_t)i * arity;}
+    const vector<int>& getData() const {return data;}
+    // Sorts and deduplicates the tuples of data (its size has to be a multiple of the arity)
+    void setData(vector<int> data);
+    // Same as setData, for tuples that are already sorted and deduplicated
+    void setSortedData(vector<int> data) {checkDataSize(data); this->data = move(data);}
+};
+
+static long long tupleBytes(const dynamicRelation& inputRelation) {
+    return (long long)inputRelation.getData().size() * sizeof(int);
+}
+
+template <size_t arity>
+static void sortAndDeduplicateFixedRows(vector<int>& data) {
+    static_assert(sizeof(array<int, arity>) == arity * sizeof(int), "tuples must have the same layout as the flat buffer");
+    array<int, arity>* first = reinterpret_cast<array<int, arity>*>(data.data());
+    array<int, arity>* last = first + data.size() / arity;
+    sort(first, last);
+    data.resize((unique(first, last) - first) * arity);
+}
+
+// Sorts the row-major tuples of data lexicographically and removes the duplicates
+static void sortAndDeduplicateRows(vector<int>& data, int arity) {
+    switch (arity) {
+        case 1: sortAndDeduplicateFixedRows<1>(data); return;
+        case 2: sortAndDeduplicateFixedRows<2>(data); return;
+        case 3: sortAndDeduplicateFixedRows<3>(data); return;
+        case 4: sortAndDeduplicateFixedRows<4>(data); return;
+        case 5: sortAndDeduplicateFixedRows<5>(data); return;
+        case 6: sortAndDeduplicateFixedRows<6>(data); return;
+        case 7: sortAndDeduplicateFixedRows<7>(data); return;
+        case 8: sortAndDeduplicateFixedRows<8>(data); return;
+    }
+
+    // Wider tuples: sort the row numbers, then copy the rows in order
+    size_t tupleCount = data.size() / arity;
+    vector<size_t> rows(tupleCount);
+    for (size_t i = 0; i < tupleCount; ++i)
+        rows[i] = i;
+    auto rowLess = [&](size_t row1, size_t row2) {
+        return lexicographical_compare(&data[row1 * arity], &data[row1 * arity] + arity, &data[row2 * arity], &data[row2 * arity] + arity);
+    };
+    auto rowEqual = [&](size_t row1, size_t row2) {
+        return equal(&data[row1 * arity], &data[row1 * arity] + arity, &data[row2 * arity]);
+    };
+    sort(rows.begin(), rows.end(), rowLess);
+    rows.erase(unique(rows.begin(), rows.end(), rowEqual), rows.end());
+
+    vector<int> sortedData(rows.size() * arity);
+    for (size_t i = 0; i < rows.size(); ++i)
+        copy(&data[rows[i] * arity], &data[rows[i] * arity] + arity, &sortedData[i * arity]);
+    data = move(sortedData);
+}
+
+dynamicRelation::dynamicRelation(int arity)
+{
+    if (arity < 1) {
+        cout << "A relation must have at least one column" << endl;
+        exit(1);
+    }
+    this->arity = arity;
+}
+
+dynamicRelation::dynamicRelation(const char *filename, int arity) : dynamicRelation(arity)
+{
+    loadFromFile(filename);
+}
+
+void dynamicRelation::checkDataSize(const vector<int>& data) const
+{
+    if (data.size() % arity != 0) {
+        cout << "The data of a relation of arity " << arity << " must hold a multiple of " << arity << " ints" << endl;
+        exit(1);
+    }
+}
+
+void dynamicRelation::setData(vector<int> data)
+{
+    checkDataSize(data);
+    sortAndDeduplicateRows(data, arity);
+    this->data = move(data);
+}
+
+// Loads a raw binary file of n x arity integers, like relation::loadFromFile
+void dynamicRelation::loadFromFile(const char* filename)
+{
+    profileScope profile("loadFromFile");
+    FILE* pFile;
+    errno_t err = fopen_s(&pFile, filename, "rb");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    fseek(pFile, 0, SEEK_END);
+    long fileSize = ftell(pFile);
+    rewind(pFile);
+    profile.addBytesRead(fileSize);
+
+    vector<int> fileData(fileSize / (sizeof(int) * arity) * arity);
+    size_t result = fread(fileData.data(), sizeof(int), fileData.size(), pFile);
+    fclose(pFile);
+    if (result != fileData.size())
+    {
+        cout << "File reading error" << endl;
+        exit(1);
+    }
+    setData(move(fileData));
+    profile.setOutput(getTupleCount(), 0);
+}
+
+void dynamicRelation::saveToFile(const char* filename) const
+{
+    profileScope profile("saveToFile");
+    profile.addInputTuples(getTupleCount());
+    profile.setOutput(getTupleCount(), tupleBytes(*this));
+    // The file can also be loaded as a relation<arity>, so the indexes of its previous content must go
+    removeIndexFiles(filename, arity);
+    FILE* pFile;
+    errno_t err = fopen_s(&pFile, filename, "wb");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    fwrite(data.data(), sizeof(int), data.size(), pFile);
+    fclose(pFile);
+}
+
+void dynamicRelation::printRelation() const
+{
+    cout << "Number of tuples in the relation: " << getTupleCount() << endl;
+    for (int i = 0; i < getTupleCount(); ++i)
+    {
+        const int* tuple = getTuple(i);
+        for (int j = 0; j < arity; j++)
+        {
+            if (j < arity - 1)
+                cout << tuple[j] << " ";
+            else
+                cout << tuple[j] << endl;
+        }
+    }
+}
+
+template <size_t arity>
+static dynamicRelation toDynamicRelation(const relation<arity>& inputRelation) {
+    vector<int> data;
+    data.reserve((size_t)inputRelation.getTupleCount() * arity);
+    inputRelation.forEachTuple([&](const array<int, arity>& tuple) {data.insert(data.end(), tuple.begin(), tuple.end());});
+    dynamicRelation outputRelation(arity);
+    if (inputRelation.isSorted())
+        outputRelation.setSortedData(move(data));
+    else
+        outputRelation.setData(move(data));
+    return outputRelation;
+}
+
+template <size_t arity>
+static relation<arity> toStaticRelation(const dynamicRelation& inputRelation, int storageMode = FLAT_STORAGE) {
+    if (inputRelation.getArity() != (int)arity) {
+        cout << "The relation has arity " << inputRelation.getArity() << ", not " << arity << endl;
+        exit(1);
+    }
+    vector<array<int, arity>> tuples(inputRelation.getTupleCount());
+    if (!tuples.empty())
+        memcpy(tuples.data(), inputRelation.getData().data(), inputRelation.getData().size() * sizeof(int));
+    relation<arity> outputRelation;
+    outputRelation.setSortedFlatBuffer(move(tuples));
+    outputRelation.setStorageMode(storageMode);
+    return outputRelation;
+}
+
+static dynamicRelation selection(const dynamicRelation& inputRelation, const predicate* predicates, int predicateCount, int combination) {
+    profileScope profile("selection");
+    profile.addInput(inputRelation);
+    int arity = inputRelation.getArity();
+    for (int i = 0; i < predicateCount; ++i) {
+        if (predicates[i].attributeIndex < 0 || predicates[i].attributeIndex >= arity) {
+            cout << "You are trying to do a selection on an invalid attribute" << endl;
+            exit(1);
+        }
+        if (predicates[i].operation != EQUAL && predicates[i].operation != LESSTHAN && predicates[i].operation != GREATERTHAN) {
+            cout << "A selection predicate must be EQUAL, LESSTHAN or GREATERTHAN" << endl;
+            exit(1);
+        }
+    }
+    if (combination != CONJUNCTION && combination != DISJUNCTION) {
+        cout << "Selection predicates can only be combined with CONJUNCTION or DISJUNCTION" << endl;
+        exit(1);
+    }
+
+    // Same blocks as selectContiguousTuples
+    selectionKernelFunction kernel = getSelectionKernelFunction();
+    uint64_t matchMasks[SELECTION_BLOCK_TUPLES / 64];
+    const int* tuples = inputRelation.getData().data();
+    size_t tupleCount = inputRelation.getTupleCount();
+    vector<int> outputData;
+    for (size_t blockStart = 0; blockStart < tupleCount; blockStart += SELECTION_BLOCK_TUPLES) {
+        size_t blockTuples = min(SELECTION_BLOCK_TUPLES, tupleCount - blockStart);
+        fill(matchMasks, matchMasks + (blockTuples + 63) / 64, 0);
+        kernel(tuples + blockStart * arity, blockTuples, arity, predicates, predicateCount, combination, matchMasks);
+        for (size_t word = 0; word < (blockTuples + 63) / 64; ++word) {
+            for (uint64_t mask = matchMasks[word]; mask != 0; mask &= mask - 1) {
+                const int* tuple = tuples + (blockStart + word * 64 + countTrailingZeros(mask)) * arity;
+                outputData.insert(outputData.end(), tuple, tuple + arity);
+            }
+        }
+    }
+
+    // A selection keeps the order of the input
+    dynamicRelation outputRelation(arity);
+    outputRelation.setSortedData(move(outputData));
+    return profile.finish(move(outputRelation));
+}
+
+static dynamicRelation selection(const dynamicRelation& inputRelation, int attributeIndex, int operation, int operand) {
+    predicate condition = {attributeIndex, operation, operand};
+    return selection(inputRelation, &condition, 1, CONJUNCTION);
+}
+
+static dynamicRelation projection(const dynamicRelation& inputRelation, const int* indicesOfAttributesToKeepArray, int outputArity) {
+    profileScope profile("projection");
+    profile.addInput(inputRelation);
+    int inputArity = inputRelation.getArity();
+    if (inputArity < outputArity) {
+        cout << "You are trying to keep more columns than what exists in the relation" << endl;
+        exit(1);
+    }
+    for (int i = 0; i < outputArity; ++i) {
+        if (indicesOfAttributesToKeepArray[i] < 0 || indicesOfAttributesToKeepArray[i] >= inputArity) {
+            cout << "You are trying to keep a column that does not exist in the relation" << endl;
+            exit(1);
+        }
+    }
+
+    vector<int> outputData((size_t)inputRelation.getTupleCount() * outputArity);
+    int* outputTuple = outputData.data();
+    for (int i = 0; i < inputRelation.getTupleCount(); ++i, outputTuple += outputArity) {
+        const int* tuple = inputRelation.getTuple(i);
+        for (int j = 0; j < outputArity; ++j)
+            outputTuple[j] = tuple[indicesOfAttributesToKeepArray[j]];
+    }
+    dynamicRelation outputRelation(outputArity);
+    outputRelation.setData(move(outputData));
+    return profile.finish(move(outputRelation));
+}
+
+static dynamicRelation crossProduct(const dynamicRelation& inputRelation1, const dynamicRelation& inputRelation2) {
+    profileScope profile("crossProduct");
+    profile.addInput(inputRelation1);
+    profile.addInput(inputRelation2);
+    int arity1 = inputRelation1.getArity(), arity2 = inputRelation2.getArity();
+    vector<int> outputData;
+    outputData.reserve((size_t)inputRelation1.getTupleCount() * inputRelation2.getTupleCount() * (arity1 + arity2));
+    for (int i = 0; i < inputRelation1.getTupleCount(); ++i) {
+        for (int j = 0; j < inputRelation2.getTupleCount(); ++j) {
+            outputData.insert(outputData.end(), inputRelation1.getTuple(i), inputRelation1.getTuple(i) + arity1);
+            outputData.insert(outputData.end(), inputRelation2.getTuple(j), inputRelation2.getTuple(j) + arity2);
+        }
+    }
+    // Both inputs are sorted and deduplicated, so the concatenated tuples are too
+    dynamicRelation outputRelation(arity1 + arity2);
+    outputRelation.setSortedData(move(outputData));
+    return profile.finish(move(outputRelation));
+}
+
+// Same hash as joinKeyHash, computed on the join columns of a tuple
+static size_t hashJoinColumns(const int* tuple, int joinColumnIndexLength, const int* joinColumnIndexArray) {
+    size_t seed = 0;
+    for (int i = 0; i < joinColumnIndexLength; ++i)
+        seed ^= hash<int>()(tuple[joinColumnIndexArray[i]]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+}
+
+static bool joinColumnsEqual(const int* tuple1, const int* tuple2,
+    int joinColumnIndexLength, const int* relation1JoinColumnIndexArray, const int* relation2JoinColumnIndexArray) {
+    for (int i = 0; i < joinColumnIndexLength; ++i)
+        if (tuple1[relation1JoinColumnIndexArray[i]] != tuple2[relation2JoinColumnIndexArray[i]])
+            return false;
+    return true;
+}
+
+/*
+ * Hash equi-join of two dynamic relations, with the same parameters and output as equiJoinHash.
+ * The hash table maps the hash of the join columns to the tuples of the smaller relation, and every probe compares
+ * the join columns, since different keys can have the same hash.
+ */
+static dynamicRelation equiJoinHash(const dynamicRelation& inputRelation1, const dynamicRelation& inputRelation2,
+    int joinColumnIndexLength, const int* relation1JoinColumnIndexArray, const int* relation2JoinColumnIndexArray) {
+    profileScope profile("equiJoinHash");
+    profile.addInput(inputRelation1);
+    profile.addInput(inputRelation2);
+    int arity1 = inputRelation1.getArity(), arity2 = inputRelation2.getArity();
+    if (joinColumnIndexLength < 0 || joinColumnIndexLength > arity1 || joinColumnIndexLength > arity2) {
+        cout << "You are trying to join on more columns than what exists in the relations" << endl;
+        exit(1);
+    }
+    for (int i = 0; i < joinColumnIndexLength; ++i) {
+        if (relation1JoinColumnIndexArray[i] < 0 || relation1JoinColumnIndexArray[i] >= arity1
+            || relation2JoinColumnIndexArray[i] < 0 || relation2JoinColumnIndexArray[i] >= arity2) {
+            cout << "You are trying to join on a column that does not exist in the relation" << endl;
+            exit(1);
+        }
+    }
+
+    bool buildOnRelation1 = inputRelation1.getTupleCount() <= inputRelation2.getTupleCount();
+    const dynamicRelation& buildRelation = buildOnRelation1 ? inputRelation1 : inputRelation2;
+    const dynamicRelation& probeRelation = buildOnRelation1 ? inputRelation2 : inputRelation1;
+    const int* buildJoinColumnIndexArray = buildOnRelation1 ? relation1JoinColumnIndexArray : relation2JoinColumnIndexArray;
+    const int* probeJoinColumnIndexArray = buildOnRelation1 ? relation2JoinColumnIndexArray : relation1JoinColumnIndexArray;
+
+    unordered_map<size_t, vector<int>> hashTable;
+    hashTable.reserve(buildRelation.getTupleCount());
+    for (int i = 0; i < buildRelation.getTupleCount(); ++i)
+        hashTable[hashJoinColumns(buildRelation.getTuple(i), joinColumnIndexLength, buildJoinColumnIndexArray)].push_back(i);
+
+    vector<int> outputData;
+    for (int i = 0; i < probeRelation.getTupleCount(); ++i) {
+        const int* probeTuple = probeRelation.getTuple(i);
+        auto bucket = hashTable.find(hashJoinColumns(probeTuple, joinColumnIndexLength, probeJoinColumnIndexArray));
+        if (bucket == hashTable.end())
+            continue;
+        for (int buildTupleIndex : bucket->second) {
+            const int* buildTuple = buildRelation.getTuple(buildTupleIndex);
+            if (!joinColumnsEqual(buildTuple, probeTuple, joinColumnIndexLength, buildJoinColumnIndexArray, probeJoinColumnIndexArray))
+                continue;
+            // The output tuples are always (tuple of relation 1, tuple of relation 2)
+            const int* tuple1 = buildOnRelation1 ? buildTuple : probeTuple;
+            const int* tuple2 = buildOnRelation1 ? probeTuple : buildTuple;
+            outputData.insert(outputData.end(), tuple1, tuple1 + arity1);
+            outputData.insert(outputData.end(), tuple2, tuple2 + arity2);
+        }
+    }
+    dynamicRelation outputRelation(arity1 + arity2);
+    outputRelation.setData(move(outputData));
+    return profile.finish(move(outputRelation));
+}
+
+
+
+/*
+ * Cost-based multi-way joins
+ *
+ * multiWayJoin joins any number of dynamicRelations on a list of equality conditions between their columns
+ * (relation1.attributeIndex1 == relation2.attributeIndex2). Instead of joining them in the order they are written,
+ * planMultiWayJoin collects statistics (getTupleCount and the number of distinct values of every column),
+ * estimates the size of the intermediate results, and picks the left-deep join order with the smallest sum of
+ * intermediate sizes (dynamic programming over the subsets of relations), and an algorithm for every join:
+ * a cross product when no condition links the relation to the ones already joined, a nested loop join when both sides
+ * are tiny, and a hash join otherwise.
+ *
+ * The size of R join S on conditions R.a = S.b is estimated as |R| * |S| / (product of max(V(R, a), V(S, b))), where V
+ * is the number of distinct values of a column (assuming uniform, independent columns); the distinct values of a
+ * column of an intermediate result are at most its size.
+ *
+ * The output columns are the columns of relations[0], then those of relations[1], ..., whatever the join order.
+ * explainMultiWayJoin prints every step of the plan with its estimated and (once executed) actual tuple count.
+ *
+ *  For example:
+ *      vector<const dynamicRelation*> relations = {&rel2ArityA, &rel2ArityB, &rel2ArityC};
+ *      vector<joinCondition> conditions = {{0, 1, 1, 0}, {1, 1, 2, 0}};
+ *      auto rel6Arity = multiWayJoin(relations, conditions, true) - A.1 = B.0 and B.1 = C.0, prints the plan
+ */
+struct joinCondition
+{
+    int relation1;
+    int attributeIndex1;
+    int relation2;
+    int attributeIndex2;
+};
+
+enum JoinAlgorithm {
+    SCAN,                   // the first relation of the plan
+    CROSS_PRODUCT_JOIN,
+    NESTED_LOOP_JOIN,
+    HASH_JOIN
+};
+
+struct joinPlanStep
+{
+    int relationIndex;          // the relation joined at this step
+    int algorithm;
+    int joinColumnCount;        // the number of conditions used by this join
+    double estimatedTupleCount;
+    int actualTupleCount;       // -1 until the plan is executed
+    double milliseconds;
+};
+
+struct relationStatistics
+{
+    int tupleCount;
+    vector<int> distinctValueCounts;
+};
+
+// A nested loop join is used when the product of the input sizes is at most this
+static const double NESTED_LOOP_JOIN_LIMIT = 4096;
+
+static relationStatistics collectStatistics(const dynamicRelation& inputRelation) {
+    relationStatistics statistics;
+    statistics.tupleCount = inputRelation.getTupleCount();
+    vector<int> columnValues(statistics.tupleCount);
+    for (int column = 0; column < inputRelation.getArity(); ++column) {
+        for (int i = 0; i < statistics.tupleCount; ++i)
+            columnValues[i] = inputRelation.getTuple(i)[column];
+        // The first column is already sorted
+        if (column > 0)
+            sort(columnValues.begin(), columnValues.end());
+        statistics.distinctValueCounts.push_back(unique(columnValues.begin(), columnValues.end()) - columnValues.begin());
+        columnValues.resize(statistics.tupleCount);
+    }
+    return statistics;
+}
+
+static void validateJoinConditions(const vector<const dynamicRelation*>& relations, const vector<joinCondition>& conditions) {
+    if (relations.empty() || relations.size() > 16) {
+        cout << "A multi-way join takes between 1 and 16 relations" << endl;
+        exit(1);
+    }
+    for (const auto& condition : conditions) {
+        if (condition.relation1 < 0 || condition.relation1 >= (int)relations.size()
+            || condition.relation2 < 0 || condition.relation2 >= (int)relations.size() || condition.relation1 == condition.relation2) {
+            cout << "A join condition has to compare two different relations of the join" << endl;
+            exit(1);
+        }
+        if (condition.attributeIndex1 < 0 || condition.attributeIndex1 >= relations[condition.relation1]->getArity()
+            || condition.attributeIndex2 < 0 || condition.attributeIndex2 >= relations[condition.relation2]->getArity()) {
+            cout << "You are trying to join on a column that does not exist in the relation" << endl;
+            exit(1);
+        }
+    }
+}
+
+/*
+ * Picks the join order and algorithms. With costBased false the relations are joined in the order they are given
+ * (only the algorithms are chosen), which is what chaining the joins by hand does.
+ */
+static vector<joinPlanStep> planMultiWayJoin(const vector<const dynamicRelation*>& relations, const vector<joinCondition>& conditions,
+    bool costBased = true) {
+    validateJoinConditions(relations, conditions);
+    int relationCount = relations.size();
+    vector<relationStatistics> statistics;
+    for (const dynamicRelation* inputRelation : relations)
+        statistics.push_back(collectStatistics(*inputRelation));
+
+    // Estimated size of (the relations of subset) joined with relation next, and the number of conditions used
+    auto estimateJoin = [&](unsigned subset, double subsetTupleCount, int next, int& joinColumnCount) {
+        double estimate = subsetTupleCount * statistics[next].tupleCount;
+        joinColumnCount = 0;
+        for (const auto& condition : conditions) {
+            int joinedRelation, joinedColumn, nextColumn;
+            if (condition.relation2 == next && (subset >> condition.relation1 & 1)) {
+                joinedRelation = condition.relation1; joinedColumn = condition.attributeIndex1; nextColumn = condition.attributeIndex2;
+            }
+            else if (condition.relation1 == next && (subset >> condition.relation2 & 1)) {
+                joinedRelation = condition.relation2; joinedColumn = condition.attributeIndex2; nextColumn = condition.attributeIndex1;
+            }
+            else {
+                continue;
+            }
+            double joinedDistinct = min<double>(statistics[joinedRelation].distinctValueCounts[joinedColumn], subsetTupleCount);
+            double nextDistinct = statistics[next].distinctValueCounts[nextColumn];
+            estimate /= max(1.0, max(joinedDistinct, nextDistinct));
+            ++joinColumnCount;
+        }
+        return estimate;
+    };
+    auto chooseAlgorithm = [&](double leftTupleCount, int next, int joinColumnCount) {
+        if (joinColumnCount == 0)
+            return (int)CROSS_PRODUCT_JOIN;
+        return leftTupleCount * statistics[next].tupleCount <= NESTED_LOOP_JOIN_LIMIT ? (int)NESTED_LOOP_JOIN : (int)HASH_JOIN;
+    };
+
+    vector<int> order;
+    if (!costBased) {
+        for (int i = 0; i < relationCount; ++i)
+            order.push_back(i);
+    }
+    else {
+        // best*[subset]: the cheapest left-deep plan that joins exactly the relations of subset
+        unsigned subsetCount = 1u << relationCount;
+        vector<double> bestCost(subsetCount, -1), bestTupleCount(subsetCount, 0);
+        vector<int> bestLast(subsetCount, -1);
+        for (int i = 0; i < relationCount; ++i) {
+            bestCost[1u << i] = 0;
+            bestTupleCount[1u << i] = statistics[i].tupleCount;
+            bestLast[1u << i] = i;
+        }
+        for (unsigned subset = 1; subset < subsetCount; ++subset) {
+            if (bestCost[subset] < 0)
+                continue;
+            for (int next = 0; next < relationCount; ++next) {
+                if (subset >> next & 1)
+                    continue;
+                int joinColumnCount;
+                double estimate = estimateJoin(subset, bestTupleCount[subset], next, joinColumnCount);
+                double cost = bestCost[subset] + estimate;
+                unsigned extended = subset | (1u << next);
+                if (bestCost[extended] < 0 || cost < bestCost[extended]) {
+                    bestCost[extended] = cost;
+                    bestTupleCount[extended] = estimate;
+                    bestLast[extended] = next;
+                }
+            }
+        }
+        for (unsigned subset = subsetCount - 1; subset != 0; subset &= ~(1u << bestLast[subset]))
+            order.push_back(bestLast[subset]);
+        reverse(order.begin(), order.end());
+    }
+
+    vector<joinPlanStep> plan;
+    unsigned joined = 1u << order[0];
+    double tupleCount = statistics[order[0]].tupleCount;
+    plan.push_back({order[0], SCAN, 0, tupleCount, -1, 0});
+    for (int i = 1; i < relationCount; ++i) {
+        int joinColumnCount;
+        double estimate = estimateJoin(joined, tupleCount, order[i], joinColumnCount);
+        plan.push_back({order[i], chooseAlgorithm(tupleCount, order[i], joinColumnCount), joinColumnCount, estimate, -1, 0});
+        joined |= 1u << order[i];
+        tupleCount = estimate;
+    }
+    return plan;
+}
+
+// Runs a plan of planMultiWayJoin, and fills in the actual tuple count and time of every step
+static dynamicRelation executeMultiWayJoin(const vector<const dynamicRelation*>& relations, const vector<joinCondition>& conditions,
+    vector<joinPlanStep>& plan) {
+    validateJoinConditions(relations, conditions);
+    // columnOffsets[r] is the first column of relation r in the intermediate result, -1 while r is not joined yet
+    vector<int> columnOffsets(relations.size(), -1);
+    dynamicRelation intermediate;
+    for (size_t step = 0; step < plan.size(); ++step) {
+        int next = plan[step].relationIndex;
+        const dynamicRelation& nextRelation = *relations[next];
+        auto start = chrono::steady_clock::now();
+        if (plan[step].algorithm == SCAN) {
+            intermediate = nextRelation;
+        }
+        else {
+            vector<int> intermediateJoinColumns, nextJoinColumns;
+            for (const auto& condition : conditions) {
+                if (condition.relation2 == next && columnOffsets[condition.relation1] >= 0) {
+                    intermediateJoinColumns.push_back(columnOffsets[condition.relation1] + condition.attributeIndex1);
+                    nextJoinColumns.push_back(condition.attributeIndex2);
+                }
+                else if (condition.relation1 == next && columnOffsets[condition.relation2] >= 0) {
+                    intermediateJoinColumns.push_back(columnOffsets[condition.relation2] + condition.attributeIndex2);
+                    nextJoinColumns.push_back(condition.attributeIndex1);
+                }
+            }
+            int joinColumnCount = intermediateJoinColumns.size();
+            if (plan[step].algorithm == CROSS_PRODUCT_JOIN || joinColumnCount == 0) {
+                intermediate = crossProduct(intermediate, nextRelation);
+            }
+            else if (plan[step].algorithm == NESTED_LOOP_JOIN) {
+                int arity1 = intermediate.getArity(), arity2 = nextRelation.getArity();
+                vector<int> outputData;
+                for (int i = 0; i < intermediate.getTupleCount(); ++i) {
+                    for (int j = 0; j < nextRelation.getTupleCount(); ++j) {
+                        if (!joinColumnsEqual(intermediate.getTuple(i), nextRelation.getTuple(j), joinColumnCount,
+                                intermediateJoinColumns.data(), nextJoinColumns.data()))
+                            continue;
+                        outputData.insert(outputData.end(), intermediate.getTuple(i), intermediate.getTuple(i) + arity1);
+                        outputData.insert(outputData.end(), nextRelation.getTuple(j), nextRelation.getTuple(j) + arity2);
+                    }
+                }
+                // Both inputs are sorted, and the pairs are produced in order
+                dynamicRelation outputRelation(arity1 + arity2);
+                outputRelation.setSortedData(move(outputData));
+                intermediate = move(outputRelation);
+            }
+            else {
+                intermediate = equiJoinHash(intermediate, nextRelation, joinColumnCount, intermediateJoinColumns.data(), nextJoinColumns.data());
+            }
+        }
+        columnOffsets[next] = intermediate.getArity() - nextRelation.getArity();
+        plan[step].actualTupleCount = intermediate.getTupleCount();
+        plan[step].milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // Put the columns back in the order of the relations
+    vector<int> outputColumns;
+    for (size_t r = 0; r < relations.size(); ++r)
+        for (int column = 0; column < relations[r]->getArity(); ++column)
+            outputColumns.push_back(columnOffsets[r] + column);
+    return projection(intermediate, outputColumns.data(), outputColumns.size());
+}
+
+static void explainMultiWayJoin(const vector<joinPlanStep>& plan) {
+    const char* algorithmNames[4] = {"SCAN", "CROSS_PRODUCT_JOIN", "NESTED_LOOP_JOIN", "HASH_JOIN"};
+    for (size_t step = 0; step < plan.size(); ++step) {
+        cout << "step " << step + 1 << ": " << algorithmNames[plan[step].algorithm] << " relation " << plan[step].relationIndex;
+        if (plan[step].joinColumnCount > 0)
+            cout << " on " << plan[step].joinColumnCount << " column(s)";
+        cout << ", estimated " << (long long)(plan[step].estimatedTupleCount + 0.5) << " tuples";
+        if (plan[step].actualTupleCount >= 0)
+            cout << ", actual " << plan[step].actualTupleCount << " tuples, " << plan[step].milliseconds << " ms";
+        cout << endl;
+    }
+}
+
+static dynamicRelation multiWayJoin(const vector<const dynamicRelation*>& relations, const vector<joinCondition>& conditions,
+    bool explain = false) {
+    auto plan = planMultiWayJoin(relations, conditions);
+    auto outputRelation = executeMultiWayJoin(relations, conditions, plan);
+    if (explain)
+        explainMultiWayJoin(plan);
+    return outputRelation;
+}
+
+
+
+/*
+ * Leapfrog triejoin
+ *
+ * A worst-case optimal multi-way join (Veldhuizen, "Leapfrog Triejoin"). Instead of joining two relations at a time,
+ * it binds one variable at a time, in variableOrder: for every variable, the relations that contain it are
+ * intersected on it (the leapfrog, every relation seeking to the largest value of the others), and for every value in
+ * the intersection the next variable is bound. No intermediate result is built, and for cyclic queries like triangles
+ * the work is bounded by the largest possible output instead of the size of a pairwise join.
+ *
+ * A sorted relation is a trie: the tuples with the same first k values are consecutive. The columns of every relation
+ * are reordered (projection) so that its variables come in variableOrder, and trieIterator walks the trie with
+ * binary (galloping) searches on the row-major buffer of the dynamicRelation.
+ *
+ * Function parameters:
+ *      relations - the relations to join
+ *      relationVariables - relationVariables[r][c] is the variable of column c of relations[r]. Variables are numbered
+ *                          0 .. variableCount - 1, a variable can not appear twice in the same relation
+ *      variableOrder - the order in which the variables are bound (a permutation of 0 .. variableCount - 1)
+ *
+ * The output has one column per variable (column i is variable i).
+ *
+ *  For example:
+ *      vector<const dynamicRelation*> relations = {&edges, &edges, &edges};
+ *      auto triangles = leapfrogTriejoin(relations, {{0, 1}, {1, 2}, {0, 2}}, {0, 1, 2}) -
+ *                                                  every (a, b, c) with edges (a, b), (b, c) and (a, c)
+ */
+class trieIterator
+{
+private:
+    const int* data;
+    int arity;
+    size_t tupleCount;
+    int depth;
+    // At depth d the tuples that match the values opened above it are rangeBegin[d] .. rangeEnd[d] - 1,
+    // and positions[d] is the first tuple with the current value
+    vector<size_t> rangeBegin, rangeEnd, positions;
+
+    int value(size_t row) const {return data[row * arity + depth];}
+    // The first row in [first, last) whose value at the current depth is not less than key (greater than key if strict)
+    size_t gallop(size_t first, size_t last, int key, bool strict) const {
+        auto before = [&](size_t row) {return strict ? value(row) <= key : value(row) < key;};
+        size_t low = first, step = 1;
+        while (low + step < last && before(low + step)) {
+            low += step;
+            step <<= 1;
+        }
+        size_t high = min(low + step, last);
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (before(middle))
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        return low;
+    }
+
+public:
+    trieIterator(const dynamicRelation& inputRelation)
+        : data(inputRelation.getData().data()), arity(inputRelation.getArity()), tupleCount(inputRelation.getTupleCount()), depth(-1),
+          rangeBegin(arity), rangeEnd(arity), positions(arity) {}
+
+    int key() const {return value(positions[depth]);}
+    bool atEnd() const {return positions[depth] >= rangeEnd[depth];}
+    // Moves to the next value at the current depth
+    void next() {positions[depth] = gallop(positions[depth], rangeEnd[depth], key(), true);}
+    // Moves to the first value not less than key at the current depth
+    void seek(int key) {positions[depth] = gallop(positions[depth], rangeEnd[depth], key, false);}
+    // Goes down to the first column, or to the values of the next column that follow the current value
+    void open() {
+        size_t first = 0, last = tupleCount;
+        if (depth >= 0) {
+            first = positions[depth];
+            last = gallop(first, rangeEnd[depth], key(), true);
+        }
+        ++depth;
+        rangeBegin[depth] = positions[depth] = first;
+        rangeEnd[depth] = last;
+    }
+    void up() {--depth;}
+};
+
+// Binds the variables from variableOrder[variable] on, calling emit(bindings) for every complete binding
+template <class Emit>
+static void leapfrogTriejoinAt(vector<trieIterator>& iterators, const vector<vector<int>>& variableIterators,
+    const vector<int>& variableOrder, size_t variable, vector<int>& bindings, Emit& emit) {
+    if (variable == variableOrder.size()) {
+        emit(bindings.data());
+        return;
+    }
+    const vector<int>& participants = variableIterators[variableOrder[variable]];
+    for (int i : participants)
+        iterators[i].open();
+
+    // Leapfrog: keep the participants sorted by key in a ring, and let the smallest one seek to the largest key
+    vector<trieIterator*> ring;
+    bool atEnd = false;
+    for (int i : participants) {
+        ring.push_back(&iterators[i]);
+        atEnd = atEnd || iterators[i].atEnd();
+    }
+    if (!atEnd) {
+        sort(ring.begin(), ring.end(), [](const trieIterator* iterator1, const trieIterator* iterator2) {return iterator1->key() < iterator2->key();});
+        size_t p = 0;
+        int maximumKey = ring.back()->key();
+        while (true) {
+            int key = ring[p]->key();
+            if (key == maximumKey) {
+                // All the participants are at the same key
+                bindings[variableOrder[variable]] = key;
+                leapfrogTriejoinAt(iterators, variableIterators, variableOrder, variable + 1, bindings, emit);
+                ring[p]->next();
+            }
+            else {
+                ring[p]->seek(maximumKey);
+            }
+            if (ring[p]->atEnd())
+                break;
+            maximumKey = ring[p]->key();
+            p = (p + 1) % ring.size();
+        }
+    }
+
+    for (int i : participants)
+        iterators[i].up();
+}
+
+/*
+ * Runs the leapfrog triejoin and calls emit(bindings) for every output tuple, where bindings[i] is the value of
+ * variable i. leapfrogTriejoin collects the tuples into a relation, this can also count them without storing them.
+ */
+template <class Emit>
+static void leapfrogTriejoinVisit(const vector<const dynamicRelation*>& relations, const vector<vector<int>>& relationVariables,
+    const vector<int>& variableOrder, Emit emit) {
+    size_t variableCount = variableOrder.size();
+    if (relationVariables.size() != relations.size()) {
+        cout << "Every relation of the join needs its list of variables" << endl;
+        exit(1);
+    }
+    // orderPosition[v] is the position of variable v in variableOrder
+    vector<int> orderPosition(variableCount, -1);
+    for (size_t i = 0; i < variableCount; ++i) {
+        if (variableOrder[i] < 0 || variableOrder[i] >= (int)variableCount || orderPosition[variableOrder[i]] >= 0) {
+            cout << "The variable order has to be a permutation of the variables" << endl;
+            exit(1);
+        }
+        orderPosition[variableOrder[i]] = i;
+    }
+
+    // Reorder the columns of every relation to follow the variable order
+    vector<dynamicRelation> reorderedRelations;
+    reorderedRelations.reserve(relations.size());
+    vector<vector<int>> variableIterators(variableCount);
+    for (size_t r = 0; r < relations.size(); ++r) {
+        vector<int> columns(relations[r]->getArity());
+        if (relationVariables[r].size() != columns.size()) {
+            cout << "Relation " << r << " needs one variable per column" << endl;
+            exit(1);
+        }
+        for (size_t c = 0; c < columns.size(); ++c) {
+            if (relationVariables[r][c] < 0 || relationVariables[r][c] >= (int)variableCount) {
+                cout << "Unknown variable " << relationVariables[r][c] << " in relation " << r << endl;
+                exit(1);
+            }
+            columns[c] = c;
+        }
+        sort(columns.begin(), columns.end(), [&](int column1, int column2) {
+            return orderPosition[relationVariables[r][column1]] < orderPosition[relationVariables[r][column2]];
+        });
+        for (size_t c = 1; c < columns.size(); ++c) {
+            if (relationVariables[r][columns[c]] == relationVariables[r][columns[c - 1]]) {
+                cout << "A variable can not appear twice in relation " << r << endl;
+                exit(1);
+            }
+        }
+        reorderedRelations.push_back(projection(*relations[r], columns.data(), columns.size()));
+        for (int column : columns)
+            variableIterators[relationVariables[r][column]].push_back(r);
+    }
+    for (size_t v = 0; v < variableCount; ++v) {
+        if (variableIterators[v].empty()) {
+            cout << "Variable " << v << " does not appear in any relation" << endl;
+            exit(1);
+        }
+    }
+
+    vector<trieIterator> iterators;
+    for (const auto& reorderedRelation : reorderedRelations)
+        iterators.emplace_back(reorderedRelation);
+    vector<int> bindings(variableCount);
+    leapfrogTriejoinAt(iterators, variableIterators, variableOrder, 0, bindings, emit);
+}
+
+static dynamicRelation leapfrogTriejoin(const vector<const dynamicRelation*>& relations, const vector<vector<int>>& relationVariables,
+    const vector<int>& variableOrder) {
+    int variableCount = variableOrder.size();
+    vector<int> outputData;
+    leapfrogTriejoinVisit(relations, relationVariables, variableOrder, [&](const int* bindings) {
+        outputData.insert(outputData.end(), bindings, bindings + variableCount);
+    });
+    // The tuples come out sorted in variable order, so they only have to be sorted again for another order
+    dynamicRelation outputRelation(variableCount);
+    if (is_sorted(variableOrder.begin(), variableOrder.end()))
+        outputRelation.setSortedData(move(outputData));
+    else
+        outputRelation.setData(move(outputData));
+    return outputRelation;
+}
+
+
+
+/*
+ * Incremental view maintenance
+ *
+ * A baseRelation is a relation whose changes (deltas: tuples inserted and deleted) are pushed to the views defined
+ * on it. A view (selectionView, projectionView, equiJoinView) is a derived relation that is computed once when it is
+ * created and then kept up to date from the deltas of its inputs, which can be base relations or other views:
+ *  selectionView - keeps the inserted / deleted tuples that satisfy the predicates
+ *  projectionView - counts how many input tuples give each output tuple, a tuple is only deleted from the view when
+ *                   its count drops to 0
+ *  equiJoinView - keeps both inputs in hash tables on the join key, and joins a delta of one input with the
+ *                 current tuples of the other one
+ * So an update costs about the size of the delta (and of the join matches of its tuples), not of the relations.
+ * getRelation() is the current content of a base relation or a view, in TREE_STORAGE.
+ *
+ *  For example:
+ *      baseRelation<3> orders(relation<3>("./orders"));
+ *      baseRelation<2> customers(relation<2>("./customers"));
+ *      selectionView<3> bigOrders(orders, 2, GREATERTHAN, 1000);
+ *      int joinColumns1[1] = {0}, joinColumns2[1] = {0};
+ *      equiJoinView<3, 2> bigOrderCustomers(bigOrders, customers, 1, joinColumns1, joinColumns2);
+ *      orders.insertFromFile("./newOrders");   -- bigOrderCustomers.getRelation() now has the new big orders
+ *
+ *  Note:
+ *          A delta deletes its deleted tuples before it inserts its inserted tuples, the tuples that a relation
+ *          already has (or does not have) are ignored
+ *          A view must be destroyed before the relations and views it is defined on
+ */
+template <size_t arity>
+class deltaSource
+{
+public:
+    typedef function<void(const vector<array<int, arity>>& insertedTuples, const vector<array<int, arity>>& deletedTuples)> deltaListener;
+
+protected:
+    relation<arity> result;
+    // In the order they were added, so a view defined twice on the same source (a self-join) sees its first input change first
+    map<int, deltaListener> listeners;
+    int nextListenerId;
+
+    // Applies the delta to result, and passes the tuples that really changed to the listeners
+    void update(const vector<array<int, arity>>& insertedTuples, const vector<array<int, arity>>& deletedTuples);
+
+public:
+    deltaSource() : nextListenerId(0) {}
+    virtual ~deltaSource() {}
+    deltaSource(const deltaSource&) = delete;
+    deltaSource& operator=(const deltaSource&) = delete;
+
+    const relation<arity>& getRelation() const {return result;}
+    int addListener(deltaListener listener) {listeners[nextListenerId] = move(listener); return nextListenerId++;}
+    void removeListener(int listenerId) {listeners.erase(listenerId);}
+};
+
+template <size_t arity>
+void deltaSource<arity>::update(const vector<array<int, arity>>& insertedTuples, const vector<array<int, arity>>& deletedTuples)
+{
+    vector<array<int, arity>> inserted, deleted;
+    for (const auto& tuple : deletedTuples)
+        if (result.eraseTuple(tuple))
+            deleted.push_back(tuple);
+    for (const auto& tuple : insertedTuples)
+        if (result.insertTuple(tuple))
+            inserted.push_back(tuple);
+    if (inserted.empty() && deleted.empty())
+        return;
+    for (auto& listener : listeners)
+        listener.second(inserted, deleted);
+}
+
+template <size_t arity>
+class baseRelation : public deltaSource<arity>
+{
+public:
+    explicit baseRelation(relation<arity> initialRelation = relation<arity>()) {
+        this->result = move(initialRelation);
+        this->result.setStorageMode(TREE_STORAGE);
+    }
+
+    void applyDelta(const vector<array<int, arity>>& insertedTuples, const vector<array<int, arity>>& deletedTuples) {
+        this->update(insertedTuples, deletedTuples);
+    }
+    void insert(const vector<array<int, arity>>& tuples) {this->update(tuples, vector<array<int, arity>>());}
+    void erase(const vector<array<int, arity>>& tuples) {this->update(vector<array<int, arity>>(), tuples);}
+    // Inserts the tuples of a raw binary file (e.g. the tuples appended to the base file)
+    void insertFromFile(const char* filename);
+};
+
+template <size_t arity>
+void baseRelation<arity>::insertFromFile(const char* filename)
+{
+    FILE* pFile;
+    errno_t err = fopen_s(&pFile, filename, "rb");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    fseek(pFile, 0, SEEK_END);
+    long fileSize = ftell(pFile);
+    rewind(pFile);
+    vector<array<int, arity>> fileTuples(fileSize / sizeof(array<int, arity>));
+    size_t result = fread(fileTuples.data(), sizeof(array<int, arity>), fileTuples.size(), pFile);
+    fclose(pFile);
+    if (result != fileTuples.size())
+    {
+        cout << "File reading error" << endl;
+        exit(1);
+    }
+    insert(fileTuples);
+}
+
+template <size_t arity>
+class selectionView : public deltaSource<arity>
+{
+private:
+    deltaSource<arity>& source;
+    int listenerId;
+    vector<predicate> predicates;
+    int combination;
+
+    void filter(const vector<array<int, arity>>& tuples, vector<array<int, arity>>& selectedTuples) const {
+        for (const auto& tuple : tuples)
+            if (predicatesHold(tuple.data(), predicates.data(), (int)predicates.size(), combination))
+                selectedTuples.push_back(tuple);
+    }
+
+public:
+    selectionView(deltaSource<arity>& source, const predicate* predicates, int predicateCount, int combination);
+    selectionView(deltaSource<arity>& source, int attributeIndex, int operation, int operand);
+    ~selectionView() {source.removeListener(listenerId);}
+};
+
+template <size_t arity>
+selectionView<arity>::selectionView(deltaSource<arity>& source, const predicate* predicates, int predicateCount, int combination)
+    : source(source), predicates(predicates, predicates + predicateCount), combination(combination)
+{
+    this->result = selection<arity>(source.getRelation(), predicates, predicateCount, combination);
+    this->result.setStorageMode(TREE_STORAGE);
+    listenerId = source.addListener([this](const vector<array<int, arity>>& insertedTuples, const vector<array<int, arity>>& deletedTuples) {
+        vector<array<int, arity>> inserted, deleted;
+        filter(insertedTuples, inserted);
+        filter(deletedTuples, deleted);
+        this->update(inserted, deleted);
+    });
+}
+
+template <size_t arity>
+selectionView<arity>::selectionView(deltaSource<arity>& source, int attributeIndex, int operation, int operand)
+    : selectionView(source, vector<predicate>{{attributeIndex, operation, operand}}.data(), 1, CONJUNCTION)
+{
+}
+
+template <size_t inputArity, size_t outputArity>
+class projectionView : public deltaSource<outputArity>
+{
+private:
+    deltaSource<inputArity>& source;
+    int listenerId;
+    array<int, outputArity> indicesOfAttributesToKeep;
+    // The number of input tuples that give each output tuple
+    unordered_map<array<int, outputArity>, int, joinKeyHash<outputArity>> counts;
+
+    array<int, outputArity> project(const array<int, inputArity>& tuple) const {
+        array<int, outputArity> outputTuple;
+        for (size_t i = 0; i < outputArity; ++i)
+            outputTuple[i] = tuple[indicesOfAttributesToKeep[i]];
+        return outputTuple;
+    }
+
+public:
+    projectionView(deltaSource<inputArity>& source, int* indicesOfAttributesToKeepArray);
+    ~projectionView() {source.removeListener(listenerId);}
+};
+
+template <size_t inputArity, size_t outputArity>
+projectionView<inputArity, outputArity>::projectionView(deltaSource<inputArity>& source, int* indicesOfAttributesToKeepArray)
+    : source(source)
+{
+    this->result = projection<inputArity, outputArity>(source.getRelation(), indicesOfAttributesToKeepArray);
+    this->result.setStorageMode(TREE_STORAGE);
+    for (size_t i = 0; i < outputArity; ++i)
+        indicesOfAttributesToKeep[i] = indicesOfAttributesToKeepArray[i];
+    counts.reserve(source.getRelation().getTupleCount());
+    source.getRelation().forEachTuple([&](const array<int, inputArity>& tuple) {++counts[project(tuple)];});
+
+    listenerId = source.addListener([this](const vector<array<int, inputArity>>& insertedTuples, const vector<array<int, inputArity>>& deletedTuples) {
+        vector<array<int, outputArity>> inserted, deleted;
+        for (const auto& tuple : deletedTuples) {
+            auto count = counts.find(project(tuple));
+            if (--count->second == 0) {
+                deleted.push_back(count->first);
+                counts.erase(count);
+            }
+        }
+        for (const auto& tuple : insertedTuples) {
+            auto outputTuple = project(tuple);
+            if (++counts[outputTuple] == 1)
+                inserted.push_back(outputTuple);
+        }
+        this->update(inserted, deleted);
+    });
+}
+
+template <size_t inputArity1, size_t inputArity2>
+class equiJoinView : public deltaSource<inputArity1 + inputArity2>
+{
+private:
+    static constexpr size_t keyArity = inputArity1 < inputArity2 ? inputArity1 : inputArity2;
+    template <size_t arity>
+    using keyTable = unordered_map<array<int, keyArity>, vector<array<int, arity>>, joinKeyHash<keyArity>>;
+
+    deltaSource<inputArity1>& source1;
+    deltaSource<inputArity2>& source2;
+    int listenerId1, listenerId2;
+    int joinColumnIndexLength;
+    array<int, keyArity> joinColumns1, joinColumns2;
+    // The current tuples of each input, by join key
+    keyTable<inputArity1> tuples1;
+    keyTable<inputArity2> tuples2;
+
+    template <size_t arity>
+    static void eraseFromTable(keyTable<arity>& table, const array<int, keyArity>& key, const array<int, arity>& tuple);
+
+public:
+    equiJoinView(deltaSource<inputArity1>& source1, deltaSource<inputArity2>& source2,
+        int joinColumnIndexLength, int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray);
+    ~equiJoinView() {source1.removeListener(listenerId1); source2.removeListener(listenerId2);}
+};
+
+template <size_t inputArity1, size_t inputArity2>
+template <size_t arity>
+void equiJoinView<inputArity1, inputArity2>::eraseFromTable(keyTable<arity>& table, const array<int, keyArity>& key, const array<int, arity>& tuple)
+{
+    auto bucket = table.find(key);
+    auto position = find(bucket->second.begin(), bucket->second.end(), tuple);
+    *position = bucket->second.back();
+    bucket->second.pop_back();
+    if (bucket->second.empty())
+        table.erase(bucket);
+}
+
+template <size_t inputArity1, size_t inputArity2>
+equiJoinView<inputArity1, inputArity2>::equiJoinView(deltaSource<inputArity1>& source1, deltaSource<inputArity2>& source2,
+    int joinColumnIndexLength, int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray)
+    : source1(source1), source2(source2), joinColumnIndexLength(joinColumnIndexLength)
+{
+    this->result = equiJoinHash<inputArity1, inputArity2>(source1.getRelation(), source2.getRelation(), joinColumnIndexLength,
+        relation1JoinColumnIndexArray, relation2JoinColumnIndexArray);
+    this->result.setStorageMode(TREE_STORAGE);
+    for (int i = 0; i < joinColumnIndexLength; ++i) {
+        joinColumns1[i] = relation1JoinColumnIndexArray[i];
+        joinColumns2[i] = relation2JoinColumnIndexArray[i];
+    }
+    source1.getRelation().forEachTuple([&](const array<int, inputArity1>& tuple) {
+        tuples1[extractJoinKey<keyArity>(tuple, joinColumnIndexLength, joinColumns1.data())].push_back(tuple);
+    });
+    source2.getRelation().forEachTuple([&](const array<int, inputArity2>& tuple) {
+        tuples2[extractJoinKey<keyArity>(tuple, joinColumnIndexLength, joinColumns2.data())].push_back(tuple);
+    });
+
+    // A delta of one input is joined with the other input as it was before the delta; with a self-join, the
+    // second listener then sees the first input after the delta, which gives every new pair exactly once
+    listenerId1 = source1.addListener([this](const vector<array<int, inputArity1>>& insertedTuples, const vector<array<int, inputArity1>>& deletedTuples) {
+        vector<array<int, inputArity1 + inputArity2>> inserted, deleted;
+        for (const auto& tuple : deletedTuples) {
+            auto key = extractJoinKey<keyArity>(tuple, this->joinColumnIndexLength, joinColumns1.data());
+            eraseFromTable<inputArity1>(tuples1, key, tuple);
+            auto matches = tuples2.find(key);
+            if (matches != tuples2.end())
+                for (const auto& match : matches->second)
+                    deleted.push_back(concatenateTuples<inputArity1, inputArity2>(tuple, match));
+        }
+        for (const auto& tuple : insertedTuples) {
+            auto key = extractJoinKey<keyArity>(tuple, this->joinColumnIndexLength, joinColumns1.data());
+            tuples1[key].push_back(tuple);
+            auto matches = tuples2.find(key);
+            if (matches != tuples2.end())
+                for (const auto& match : matches->second)
+                    inserted.push_back(concatenateTuples<inputArity1, inputArity2>(tuple, match));
+        }
+        this->update(inserted, deleted);
+    });
+    listenerId2 = source2.addListener([this](const vector<array<int, inputArity2>>& insertedTuples, const vector<array<int, inputArity2>>& deletedTuples) {
+        vector<array<int, inputArity1 + inputArity2>> inserted, deleted;
+        for (const auto& tuple : deletedTuples) {
+            auto key = extractJoinKey<keyArity>(tuple, this->joinColumnIndexLength, joinColumns2.data());
+            eraseFromTable<inputArity2>(tuples2, key, tuple);
+            auto matches = tuples1.find(key);
+            if (matches != tuples1.end())
+                for (const auto& match : matches->second)
+                    deleted.push_back(concatenateTuples<inputArity1, inputArity2>(match, tuple));
+        }
+        for (const auto& tuple : insertedTuples) {
+            auto key = extractJoinKey<keyArity>(tuple, this->joinColumnIndexLength, joinColumns2.data());
+            tuples2[key].push_back(tuple);
+            auto matches = tuples1.find(key);
+            if (matches != tuples1.end())
+                for (const auto& match : matches->second)
+                    inserted.push_back(concatenateTuples<inputArity1, inputArity2>(match, tuple));
+        }
+        this->update(inserted, deleted);
+    });
+}
+
+/*
+ * Semi-join reduction
+ *
+ * A bloomFilter is a compact set of join keys (BLOOM_BITS_PER_KEY bits per key) that can tell that a key is not in
+ * the set: every key that was added is found, and about 1% of the other keys are found too. Each key sets
+ * BLOOM_HASH_COUNT bits of a single 64-byte block, so a lookup reads one cache line.
+ * semiJoinReduce keeps the tuples of a relation whose join key may be in a filter, that is every tuple that can
+ * have a match, plus about 1% of the others. semiJoinReducedJoin runs it before a join:
+ *  REDUCE_SECOND - inputRelation2 is filtered with the join keys of inputRelation1
+ *  REDUCE_FIRST - inputRelation1 is filtered with the join keys of inputRelation2
+ *  REDUCE_BOTH - inputRelation2 is filtered first, then inputRelation1 with the keys left in the reduced inputRelation2
+ * and then calls join(reducedRelation1, reducedRelation2, joinColumnIndexLength, relation1JoinColumnIndexArray,
+ * relation2JoinColumnIndexArray) with any of the joins, which returns the same relation as on the full inputs.
+ *
+ *  For example:
+ *      auto joined = semiJoinReducedJoin<4, 4>(rel1, rel2, 1, joinColumns1, joinColumns2,
+ *          [](const relation<4>& r1, const relation<4>& r2, int n, int* c1, int* c2) {return equiJoinQuadratic<4, 4>(r1, r2, n, c1, c2);});
+ *
+ *  Note:
+ *          A reduction costs one scan of each input, and a copy of the tuples it keeps. It pays off when most tuples
+ *          have no match (like case 2) before equiJoinQuadratic and equiJoinHash; when most of them match, or before
+ *          equiJoinSortMerge of inputs already sorted on the join key (a single merge pass), the join is better run
+ *          on the full inputs
+ */
+static const int BLOOM_BITS_PER_KEY = 10;
+static const int BLOOM_HASH_COUNT = 7;
+
+enum SemiJoinDirection {
+  REDUCE_SECOND,
+  REDUCE_FIRST,
+  REDUCE_BOTH
+};
+
+class bloomFilter
+{
+private:
+    static const int BLOCK_WORDS = 8;
+    vector<uint64_t> words;
+    uint64_t blockCount;
+
+    uint64_t* blockOf(uint64_t keyHash) const {
+        return const_cast<uint64_t*>(words.data()) + ((keyHash >> 32) * blockCount >> 32) * BLOCK_WORDS;
+    }
+
+public:
+    explicit bloomFilter(size_t keyCount, int bitsPerKey = BLOOM_BITS_PER_KEY) {
+        blockCount = (keyCount * bitsPerKey + 64 * BLOCK_WORDS - 1) / (64 * BLOCK_WORDS);
+        if (blockCount == 0)
+            blockCount = 1;
+        words.assign(blockCount * BLOCK_WORDS, 0);
+    }
+
+    void add(uint64_t keyHash) {
+        uint64_t* block = blockOf(keyHash);
+        uint32_t bitHash = (uint32_t)keyHash, step = (uint32_t)(keyHash >> 23) | 1;
+        for (int i = 0; i < BLOOM_HASH_COUNT; ++i, bitHash += step)
+            block[(bitHash >> 6) & (BLOCK_WORDS - 1)] |= 1ull << (bitHash & 63);
+    }
+    bool mayContain(uint64_t keyHash) const {
+        const uint64_t* block = blockOf(keyHash);
+        uint32_t bitHash = (uint32_t)keyHash, step = (uint32_t)(keyHash >> 23) | 1;
+        for (int i = 0; i < BLOOM_HASH_COUNT; ++i, bitHash += step)
+            if ((block[(bitHash >> 6) & (BLOCK_WORDS - 1)] & (1ull << (bitHash & 63))) == 0)
+                return false;
+        return true;
+    }
+    size_t getByteCount() const {return words.size() * sizeof(uint64_t);}
+};
+
+// A well mixed 64-bit hash of the join columns of a tuple (std::hash<int> is the identity on most libraries)
+static uint64_t hashJoinKey(const int* tuple, int joinColumnIndexLength, const int* joinColumnIndexArray) {
+    uint64_t hash = 0x9e3779b97f4a7c15ull;
+    for (int i = 0; i < joinColumnIndexLength; ++i) {
+        hash ^= (uint32_t)tuple[joinColumnIndexArray[i]];
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+    }
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    return hash ^ (hash >> 33);
+}
+
+template <size_t arity>
+static bloomFilter buildJoinKeyFilter(const relation<arity>& inputRelation, int joinColumnIndexLength, const int* joinColumnIndexArray) {
+    bloomFilter filter(inputRelation.getTupleCount());
+    inputRelation.forEachTuple([&](const array<int, arity>& tuple) {
+        filter.add(hashJoinKey(tuple.data(), joinColumnIndexLength, joinColumnIndexArray));
+    });
+    return filter;
+}
+
+template <size_t arity>
+static relation<arity> semiJoinReduce(const relation<arity>& inputRelation, const bloomFilter& filter,
+    int joinColumnIndexLength, const int* joinColumnIndexArray) {
+    profileScope profile("semiJoinReduce");
+    profile.addInput(inputRelation);
+    relationBuilder<arity> outputRelation(inputRelation.getStorageMode(), inputRelation.isSorted());
+    inputRelation.forEachTuple([&](const array<int, arity>& tuple) {
+        if (filter.mayContain(hashJoinKey(tuple.data(), joinColumnIndexLength, joinColumnIndexArray)))
+            outputRelation.insert(tuple);
+    });
+    return profile.finish(outputRelation.build());
+}
+
+template <size_t inputArity1, size_t inputArity2, class Join>
+static relation<inputArity1 + inputArity2> semiJoinReducedJoin(const relation<inputArity1>& inputRelation1, const relation<inputArity2>& inputRelation2,
+    int joinColumnIndexLength, int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray, Join join, int direction = REDUCE_BOTH) {
+    if (joinColumnIndexLength < 0 || joinColumnIndexLength > (int)inputArity1 || joinColumnIndexLength > (int)inputArity2) {
+        cout << "You are trying to join on more columns than what exists in the relations" << endl;
+        exit(1);
+    }
+
+    const relation<inputArity1>* joinInput1 = &inputRelation1;
+    const relation<inputArity2>* joinInput2 = &inputRelation2;
+    relation<inputArity1> reducedRelation1;
+    relation<inputArity2> reducedRelation2;
+    if (direction != REDUCE_FIRST) {
+        reducedRelation2 = semiJoinReduce<inputArity2>(inputRelation2,
+            buildJoinKeyFilter<inputArity1>(inputRelation1, joinColumnIndexLength, relation1JoinColumnIndexArray),
+            joinColumnIndexLength, relation2JoinColumnIndexArray);
+        joinInput2 = &reducedRelation2;
+    }
+    if (direction != REDUCE_SECOND) {
+        reducedRelation1 = semiJoinReduce<inputArity1>(inputRelation1,
+            buildJoinKeyFilter<inputArity2>(*joinInput2, joinColumnIndexLength, relation2JoinColumnIndexArray),
+            joinColumnIndexLength, relation1JoinColumnIndexArray);
+        joinInput1 = &reducedRelation1;
+    }
+    return join(*joinInput1, *joinInput2, joinColumnIndexLength, relation1JoinColumnIndexArray, relation2JoinColumnIndexArray);
+}
+
+/*
+ * Group-by aggregation
+ *
+ * groupBy groups the tuples of a relation on groupArity columns (groupColumnIndexArray) and computes aggregateCount
+ * aggregates (aggregateArray) for every group, each one a function of one column:
+ *  AGGREGATE_COUNT - the number of tuples of the group (attributeIndex is ignored)
+ *  AGGREGATE_SUM, AGGREGATE_MIN, AGGREGATE_MAX - the sum / minimum / maximum of column attributeIndex over the group
+ * An output tuple is the group columns followed by the aggregates, in the order they are given. With groupArity 0
+ * the output is a single tuple of aggregates over the whole relation (and no tuple for an empty relation).
+ * The groups are kept in a hash table, so the input is scanned once, in any order, and never sorted.
+ * A TREE_STORAGE or FLAT_STORAGE relation has every tuple once, so duplicates are only counted and summed in a
+ * BAG_STORAGE relation, e.g. the projection or the join of a bag (which are bags themselves).
+ * executeGroupBy aggregates the tuples of a plan as they are produced, without materializing them at all.
+ * parallelGroupBy splits the relation into partitions like the other parallel operators. Every partition is
+ * aggregated into partial hash tables of its own, one per hash bucket of the group key, then the partial tables of
+ * each bucket are merged on one thread, so no hash table is ever shared between threads.
+ *
+ *  For example:
+ *      int groupColumnIndexArray[1] = {0};
+ *      aggregate aggregateArray[2] = {{AGGREGATE_COUNT, 0}, {AGGREGATE_SUM, 2}};
+ *      auto rel3Arity = groupBy<4, 1, 2>(rel4Arity, groupColumnIndexArray, aggregateArray) -
+ *                                                  (x, number of tuples, sum of column 2) for every value x of column 0
+ *      auto rel3Arity = executeGroupBy<2, 1, 2>(planProjection<4, 2>(planScan(rel4Arity), columns), groupColumnIndexArray,
+ *                                                  aggregateArray) - the same on the (bag) projection of rel4Arity
+ *
+ *  Note:
+ *          The aggregates are computed in 64 bits, but the output tuples are ints: a COUNT or a SUM that does not fit
+ *          in an int is an error, which names the aggregate.
+ *          The output is in the storage mode of the input relation (FLAT_STORAGE for a mapped input).
+ */
+enum AggregateFunction {
+  AGGREGATE_COUNT,
+  AGGREGATE_SUM,
+  AGGREGATE_MIN,
+  AGGREGATE_MAX
+};
+
+// One aggregate of a group-by: function (an AggregateFunction) of column attributeIndex
+struct aggregate
+{
+    int function;
+    int attributeIndex;
+};
+
+// The aggregate values of every group, keyed on its group columns
+template <size_t groupArity, size_t aggregateCount>
+using groupTable = unordered_map<array<int, groupArity>, array<long long, aggregateCount>, joinKeyHash<groupArity>>;
+
+template <size_t arity, size_t groupArity, size_t aggregateCount>
+static void checkAggregates(const int* groupColumnIndexArray, const aggregate* aggregateArray) {
+    for (size_t i = 0; i < groupArity; ++i) {
+        if (groupColumnIndexArray[i] < 0 || groupColumnIndexArray[i] >= (int)arity) {
+            cout << "You are trying to group on an invalid attribute" << endl;
+            exit(1);
+        }
+    }
+    for (size_t i = 0; i < aggregateCount; ++i) {
+        if (aggregateArray[i].function < AGGREGATE_COUNT || aggregateArray[i].function > AGGREGATE_MAX) {
+            cout << "Unknown aggregate function " << aggregateArray[i].function << endl;
+            exit(1);
+        }
+        if (aggregateArray[i].function != AGGREGATE_COUNT
+            && (aggregateArray[i].attributeIndex < 0 || aggregateArray[i].attributeIndex >= (int)arity)) {
+            cout << "You are trying to aggregate an invalid attribute" << endl;
+            exit(1);
+        }
+    }
+}
+
+// Adds one tuple to the aggregates of its group
+template <size_t arity, size_t groupArity, size_t aggregateCount>
+static void addToGroup(groupTable<groupArity, aggregateCount>& groups, const array<int, arity>& tuple,
+    const int* groupColumnIndexArray, const aggregate* aggregateArray) {
+    // A new group starts with all its values at 0
+    auto inserted = groups.try_emplace(extractJoinKey<groupArity>(tuple, (int)groupArity, groupColumnIndexArray));
+    auto& values = inserted.first->second;
+    for (size_t i = 0; i < aggregateCount; ++i) {
+        if (aggregateArray[i].function == AGGREGATE_COUNT) {
+            ++values[i];
+            continue;
+        }
+        long long value = tuple[aggregateArray[i].attributeIndex];
+        if (aggregateArray[i].function == AGGREGATE_SUM)
+            values[i] += value;
+        else if (inserted.second || (aggregateArray[i].function == AGGREGATE_MIN ? value < values[i] : value > values[i]))
+            values[i] = value;
+    }
+}
+
+// Merges partial aggregates (of the same groups, computed on other tuples) into groups
+template <size_t groupArity, size_t aggregateCount>
+static void mergeGroups(groupTable<groupArity, aggregateCount>& groups, groupTable<groupArity, aggregateCount>& partialGroups,
+    const aggregate* aggregateArray) {
+    if (groups.empty()) {
+        swap(groups, partialGroups);
+        return;
+    }
+    for (const auto& partialGroup : partialGroups) {
+        auto inserted = groups.insert(partialGroup);
+        if (inserted.second)
+            continue;
+        auto& values = inserted.first->second;
+        for (size_t i = 0; i < aggregateCount; ++i) {
+            long long value = partialGroup.second[i];
+            if (aggregateArray[i].function == AGGREGATE_COUNT || aggregateArray[i].function == AGGREGATE_SUM)
+                values[i] += value;
+            else if (aggregateArray[i].function == AGGREGATE_MIN ? value < values[i] : value > values[i])
+                values[i] = value;
+        }
+    }
+}
+
+// Only a COUNT or a SUM can overflow an int, the minimum and maximum of a column are values of the column
+template <size_t groupArity, size_t aggregateCount>
+static void insertGroups(const groupTable<groupArity, aggregateCount>& groups, relationBuilder<groupArity + aggregateCount>& outputRelation,
+    const aggregate* aggregateArray) {
+    for (const auto& group : groups) {
+        array<int, groupArity + aggregateCount> tuple;
+        copy(group.first.begin(), group.first.end(), tuple.begin());
+        for (size_t i = 0; i < aggregateCount; ++i) {
+            if (group.second[i] != (int)group.second[i]) {
+                if (aggregateArray[i].function == AGGREGATE_COUNT)
+                    cout << "The COUNT (aggregate " << i << ") " << group.second[i] << " does not fit in an int" << endl;
+                else
+                    cout << "The SUM of column " << aggregateArray[i].attributeIndex << " (aggregate " << i << ") "
+                         << group.second[i] << " does not fit in an int" << endl;
+                exit(1);
+            }
+            tuple[groupArity + i] = (int)group.second[i];
+        }
+        outputRelation.insert(tuple);
+    }
+}
+
+template <size_t arity, size_t groupArity, size_t aggregateCount>
+static relation<groupArity + aggregateCount> groupBy(const relation<arity>& inputRelation, const int* groupColumnIndexArray,
+    const aggregate* aggregateArray) {
+    profileScope profile("groupBy");
+    profile.addInput(inputRelation);
+    checkAggregates<arity, groupArity, aggregateCount>(groupColumnIndexArray, aggregateArray);
+
+    groupTable<groupArity, aggregateCount> groups;
+    inputRelation.forEachTuple([&](const array<int, arity>& tuple) {
+        addToGroup<arity, groupArity, aggregateCount>(groups, tuple, groupColumnIndexArray, aggregateArray);
+    });
+
+    relationBuilder<groupArity + aggregateCount> outputRelation(inputRelation.getStorageMode());
+    insertGroups<groupArity, aggregateCount>(groups, outputRelation, aggregateArray);
+    return profile.finish(outputRelation.build());
+}
+
+// Runs the plan and aggregates its tuples (with their duplicates, unless the plan has a planDistinct)
+template <size_t arity, size_t groupArity, size_t aggregateCount>
+static relation<groupArity + aggregateCount> executeGroupBy(streamPointer<arity> plan, const int* groupColumnIndexArray,
+    const aggregate* aggregateArray, int storageMode = TREE_STORAGE) {
+    profileScope profile("executeGroupBy");
+    checkAggregates<arity, groupArity, aggregateCount>(groupColumnIndexArray, aggregateArray);
+
+    groupTable<groupArity, aggregateCount> groups;
+    array<int, arity> tuple;
+    while (plan->next(tuple))
+        addToGroup<arity, groupArity, aggregateCount>(groups, tuple, groupColumnIndexArray, aggregateArray);
+
+    relationBuilder<groupArity + aggregateCount> outputRelation(storageMode);
+    insertGroups<groupArity, aggregateCount>(groups, outputRelation, aggregateArray);
+    return profile.finish(outputRelation.build());
+}
+
+template <size_t arity, size_t groupArity, size_t aggregateCount>
+static relation<groupArity + aggregateCount> parallelGroupBy(const relation<arity>& inputRelation, const int* groupColumnIndexArray,
+    const aggregate* aggregateArray, threadPool& pool) {
+    profileScope profile("parallelGroupBy");
+    profile.addInput(inputRelation);
+    checkAggregates<arity, groupArity, aggregateCount>(groupColumnIndexArray, aggregateArray);
+
+    size_t partitionCount = getPartitionCount(inputRelation, pool);
+    size_t bucketCount = pool.getThreadCount() * PARTITIONS_PER_THREAD;
+    // partialGroups[partition][bucket] has the groups of the partition whose key hashes to the bucket
+    vector<vector<groupTable<groupArity, aggregateCount>>> partialGroups(partitionCount,
+        vector<groupTable<groupArity, aggregateCount>>(bucketCount));
+    forEachPartition(inputRelation, partitionCount, pool, [&](size_t partition, auto first, auto last) {
+        auto& buckets = partialGroups[partition];
+        for (; first != last; ++first) {
+            size_t bucket = hashJoinKey(first->data(), (int)groupArity, groupColumnIndexArray) % bucketCount;
+            addToGroup<arity, groupArity, aggregateCount>(buckets[bucket], *first, groupColumnIndexArray, aggregateArray);
+        }
+    });
+
+    vector<groupTable<groupArity, aggregateCount>> groups(bucketCount);
+    pool.run(bucketCount, [&](size_t bucket) {
+        for (auto& buckets : partialGroups) {
+            mergeGroups<groupArity, aggregateCount>(groups[bucket], buckets[bucket], aggregateArray);
+            groupTable<groupArity, aggregateCount>().swap(buckets[bucket]);
+        }
+    });
+
+    relationBuilder<groupArity + aggregateCount> outputRelation(inputRelation.getStorageMode());
+    for (const auto& bucketGroups : groups)
+        insertGroups<groupArity, aggregateCount>(bucketGroups, outputRelation, aggregateArray);
+    return profile.finish(outputRelation.build());
+}
+
+/*
+ * Builds an in-memory relation of tupleCount random tuples, used by the benchmarks.
+ * Column keyColumn is drawn either uniformly from [0, keyRange), or skewed (Zipf-like, s = 1) so that
+ * a few keys are shared by most of the tuples, or is always 0 (DUPLICATE_KEY). All the other columns are uniform
+ * random values.
+ */
+enum KeyDistribution {
+    UNIFORM,
+    SKEWED,
+    DUPLICATE_KEY
+};
+
+template <size_t arity>
+static relation<arity> generateRelation(int tupleCount, int keyColumn, int keyDistribution, int keyRange, mt19937& generator) {
+    uniform_int_distribution<int> valueDistribution(0, 1 << 30);
+    uniform_int_distribution<int> uniformKeyDistribution(0, keyRange - 1);
+    vector<double> zipfWeights(keyRange);
+    for (int i = 0; i < keyRange; ++i)
+        zipfWeights[i] = 1.0 / (i + 1);
+    discrete_distribution<int> skewedKeyDistribution(zipfWeights.begin(), zipfWeights.end());
+
+    tupleSet<arity> dataBuffer(queryMemoryResource());
+    while ((int)dataBuffer.size() < tupleCount) {
+        array<int, arity> tuple;
+        for (size_t j = 0; j < arity; ++j)
+            tuple[j] = valueDistribution(generator);
+        if (keyDistribution == DUPLICATE_KEY)
+            tuple[keyColumn] = 0;
+        else
+            tuple[keyColumn] = (keyDistribution == SKEWED) ? skewedKeyDistribution(generator) : uniformKeyDistribution(generator);
+        dataBuffer.insert(tuple);
+    }
+
+    auto generatedRelation = relation<arity>();
+    generatedRelation.setDataBuffer(move(dataBuffer));
+    return generatedRelation;
+}
+
+/*
+ * Synthetic input files
+ *
+ * generateRelationFile writes tupleCount random tuples of arity columns to a raw binary file (the format read by
+ * loadFromFile). The tuples are generated and written in chunks, so the files can be much larger than the memory,
+ * and the same seed always gives the same file. Column keyColumn follows keyDistribution:
+ *  UNIFORM - uniform in [keyBase, keyBase + keyRange)
+ *  SKEWED - Zipf-like (s = 1) in the same range, key keyBase + i has a weight of about 1 / (i + 1). It is sampled by
+ *           inverting the continuous distribution, so it needs no table of keyRange weights
+ *  DUPLICATE_KEY - always keyBase, so that a join on the key column is a cross product (like case 1)
+ * All the other columns are uniform in [0, 2^30]. Two files with disjoint key ranges, for example keyBase 0 and
+ * keyBase keyRange, have no matching keys (like case 2).
+ *
+ *  For example:
+ *      generateRelationFile("input", 4, 1000000, 0, SKEWED, 0, 1000000, 42) -- 1M 4-arity tuples, Zipf keys in column 0
+ *
+ *  Note:
+ *          The file is not deduplicated, the tuples are distinct with a high probability if arity > 1
+ */
+class syntheticTupleGenerator
+{
+private:
+    mt19937 generator;
+    uniform_int_distribution<int> valueDistribution;
+    uniform_real_distribution<double> keyDistribution;
+    int arity, keyColumn, keyDistributionType, keyBase, keyRange;
+
+public:
+    syntheticTupleGenerator(int arity, int keyColumn, int keyDistribution, int keyBase, int keyRange, unsigned seed)
+        : generator(seed), valueDistribution(0, 1 << 30), keyDistribution(0.0, 1.0), arity(arity), keyColumn(keyColumn),
+          keyDistributionType(keyDistribution), keyBase(keyBase), keyRange(keyRange > 0 ? keyRange : 1) {}
+
+    void next(int* tuple) {
+        for (int j = 0; j < arity; ++j)
+            tuple[j] = valueDistribution(generator);
+        int key = 0;
+        if (keyDistributionType == UNIFORM)
+            key = (int)(keyDistribution(generator) * keyRange);
+        else if (keyDistributionType == SKEWED)
+            key = (int)(exp(keyDistribution(generator) * log(keyRange + 1.0))) - 1;
+        tuple[keyColumn] = keyBase + (key < keyRange ? key : keyRange - 1);
+    }
+};
+
+static void generateRelationFile(const char* filename, int arity, long long tupleCount, int keyColumn, int keyDistribution,
+    int keyBase, int keyRange, unsigned seed) {
+    if (arity <= 0 || keyColumn < 0 || keyColumn >= arity) {
+        cout << "The key column of a synthetic relation must be one of its columns" << endl;
+        exit(1);
+    }
+    removeIndexFiles(filename, arity);
+    FILE* pFile;
+    errno_t err = fopen_s(&pFile, filename, "wb");
+    if (err != 0 || pFile == NULL)
+    {
+        fputs("File error", stderr);
+        exit(1);
+    }
+    syntheticTupleGenerator tupleGenerator(arity, keyColumn, keyDistribution, keyBase, keyRange, seed);
+    vector<int> chunk((size_t)DEFAULT_STREAM_CHUNK_TUPLES * arity);
+    for (long long written = 0; written < tupleCount; ) {
+        size_t chunkTuples = (size_t)min<long long>(DEFAULT_STREAM_CHUNK_TUPLES, tupleCount - written);
+        for (size_t i = 0; i < chunkTuples; ++i)
+            tupleGenerator.next(chunk.data() + i * arity);
+        if (fwrite(chunk.data(), sizeof(int) * arity, chunkTuples, pFile) != chunkTuples)
+        {
+            fputs("File writing error", stderr);
+            exit(1);
+        }
+        written += chunkTuples;
+    }
+    fclose(pFile);
+}
+
+template <class F>
+static double measureMilliseconds(F function) {
+    auto start = chrono::steady_clock::now();
+    function();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+struct allocationMeasurement
+{
+    size_t allocations;
+    size_t bytes;
+    double milliseconds;
+    size_t peakBytes;  // the highest heap memory in use during the measurement, above what was in use before it
+};
+
+template <class F>
+static allocationMeasurement measureAllocations(F function) {
+    size_t allocationsBefore = allocationCount.load();
+    size_t bytesBefore = allocatedBytes.load();
+    size_t liveBytesBefore = liveBytes.load();
+    peakLiveBytes.store(liveBytesBefore);
+    double milliseconds = measureMilliseconds(function);
+    return {allocationCount.load() - allocationsBefore, allocatedBytes.load() - bytesBefore, milliseconds,
+            peakLiveBytes.load() - liveBytesBefore};
+}
+
+/*
+ * Compares equiJoinHash and equiJoinSortMerge against equiJoinQuadratic on a join of a 3-arity and a 2-arity relation,
+ * once with uniformly distributed join keys and once with skewed join keys.
+ */
+static void benchmarkEquiJoin() {
+    mt19937 generator(42);
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {1};
+    const char* distributionNames[2] = {"uniform", "skewed"};
+
+    for (int keyDistribution : {UNIFORM, SKEWED}) {
+        for (int tupleCount : {1000, 4000}) {
+            auto inputRelation1 = generateRelation<3>(tupleCount, 0, keyDistribution, tupleCount, generator);
+            auto inputRelation2 = generateRelation<2>(tupleCount, 1, keyDistribution, tupleCount, generator);
+
+            relation<5> quadraticOutput, hashOutput, sortMergeOutput;
+            double quadraticTime = measureMilliseconds([&]() {
+                quadraticOutput = equiJoinQuadratic<3, 2>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+            });
+            double hashTime = measureMilliseconds([&]() {
+                hashOutput = equiJoinHash<3, 2>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+            });
+            double sortMergeTime = measureMilliseconds([&]() {
+                sortMergeOutput = equiJoinSortMerge<3, 2>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+            });
+
+            bool outputsMatch = sameTuples(quadraticOutput, hashOutput)
+                             && sameTuples(quadraticOutput, sortMergeOutput);
+            cout << distributionNames[keyDistribution] << " keys, " << tupleCount << " x " << tupleCount << " tuples: "
+                 << "equiJoinQuadratic " << quadraticTime << " ms, equiJoinHash " << hashTime << " ms (speedup "
+                 << quadraticTime / hashTime << "x), equiJoinSortMerge " << sortMergeTime << " ms (speedup "
+                 << quadraticTime / sortMergeTime << "x), output " << hashOutput.getTupleCount() << " tuples"
+                 << (outputsMatch ? "" : " (OUTPUT MISMATCH)") << endl;
+        }
+    }
+}
+
+
+
+/*
+ * Loads the same 5-arity binary file (case1 style) with every storage mode, and compares load time,
+ * the time of a full scan (a selection that keeps about half of the tuples) and the approximate heap memory used by
+ * the tuples. A tree node holds the tuple plus a color and three pointers, and a typical malloc adds an 8 byte header
+ * and rounds every allocation up to 16 bytes. A mapped file uses no heap memory, only the page cache.
+ */
+static void benchmarkStorage() {
+    const char* filename = "benchmarkStorageInput";
+    const char* storageModeNames[3] = {"TREE_STORAGE", "FLAT_STORAGE", "MAPPED_STORAGE"};
+    mt19937 generator(42);
+    for (int tupleCount : {100000, 1000000}) {
+        generateRelation<5>(tupleCount, 0, UNIFORM, 1000, generator).saveToFile(filename);
+
+        for (int storageMode : {TREE_STORAGE, FLAT_STORAGE, MAPPED_STORAGE}) {
+            relation<5> inputRelation(storageMode);
+            double loadTime = measureMilliseconds([&]() {inputRelation.loadFromFile(filename);});
+            relation<5> selectionRelation;
+            double scanTime = measureMilliseconds([&]() {selectionRelation = selection<5>(inputRelation, 0, LESSTHAN, 500);});
+
+            size_t memoryBytes = 0;
+            if (storageMode == FLAT_STORAGE)
+                memoryBytes = inputRelation.getFlatBuffer().capacity() * sizeof(array<int, 5>);
+            else if (storageMode == TREE_STORAGE)
+                memoryBytes = inputRelation.getTupleCount() * ((sizeof(array<int, 5>) + 4 * sizeof(void*) + 8 + 15) / 16 * 16);
+            cout << storageModeNames[storageMode] << ", " << tupleCount << " tuples: "
+                 << "load " << loadTime << " ms, selection " << scanTime << " ms (" << selectionRelation.getTupleCount()
+                 << " tuples), ~" << memoryBytes / (1024 * 1024) << " MB" << endl;
+        }
+    }
+    remove(filename);
+}
+
+
+
+/*
+ * The operators as they were before they took their inputs by const reference, kept to measure the difference in
+ * benchmarkOperatorAllocations (TREE_STORAGE only). They take their inputs by value, copy the set of every input
+ * again (getDataBuffer() used to return it by value), and copy the output set into the output relation.
+ */
+template <size_t arity>
+static relation<arity> previousApiSelection(relation<arity> inputRelation, int attributeIndex, int operation, int operand) {
+    auto outputRelation = relation<arity>();
+    tupleSet<arity> outputDataBuffer;
+    for (const auto& tuple : tupleSet<arity>(inputRelation.getDataBuffer()))
+        if (selectionCondition(tuple[attributeIndex], operation, operand))
+            outputDataBuffer.insert(tuple);
+    outputRelation.setDataBuffer(outputDataBuffer);
+    return outputRelation;
+}
+
+template <size_t inputArity, size_t outputArity>
+static relation<outputArity> previousApiProjection(relation<inputArity> inputRelation, int* indicesOfAttributesToKeepArray) {
+    auto outputRelation = relation<outputArity>();
+    tupleSet<outputArity> outputDataBuffer;
+    for (const auto& tuple : tupleSet<inputArity>(inputRelation.getDataBuffer())) {
+        array<int, outputArity> projectedTuple;
+        for (size_t i = 0; i < outputArity; ++i)
+            projectedTuple[i] = tuple[indicesOfAttributesToKeepArray[i]];
+        outputDataBuffer.insert(projectedTuple);
+    }
+    outputRelation.setDataBuffer(outputDataBuffer);
+    return outputRelation;
+}
+
+// The second relation's set was copied once per tuple of the first relation
+template <size_t inputArity1, size_t inputArity2>
+static relation<inputArity1 + inputArity2> previousApiCrossProduct(relation<inputArity1> inputRelation1, relation<inputArity2> inputRelation2) {
+    auto outputRelation = relation<inputArity1 + inputArity2>();
+    tupleSet<inputArity1 + inputArity2> outputDataBuffer;
+    for (const auto& tuple1 : tupleSet<inputArity1>(inputRelation1.getDataBuffer()))
+        for (const auto& tuple2 : tupleSet<inputArity2>(inputRelation2.getDataBuffer()))
+            outputDataBuffer.insert(concatenateTuples<inputArity1, inputArity2>(tuple1, tuple2));
+    outputRelation.setDataBuffer(outputDataBuffer);
+    return outputRelation;
+}
+
+template <size_t inputArity1, size_t inputArity2>
+static relation<inputArity1 + inputArity2> previousApiEquiJoinHash(relation<inputArity1> inputRelation1, relation<inputArity2> inputRelation2,
+    int joinColumnIndexLength, int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray) {
+    constexpr size_t keyArity = inputArity1 < inputArity2 ? inputArity1 : inputArity2;
+    auto outputRelation = relation<inputArity1 + inputArity2>();
+    tupleSet<inputArity1 + inputArity2> outputDataBuffer;
+    const tupleSet<inputArity1> dataBuffer1 = inputRelation1.getDataBuffer();
+    const tupleSet<inputArity2> dataBuffer2 = inputRelation2.getDataBuffer();
+    unordered_map<array<int, keyArity>, vector<const array<int, inputArity1>*>, joinKeyHash<keyArity>> hashTable;
+    hashTable.reserve(dataBuffer1.size());
+    for (const auto& tuple1 : dataBuffer1)
+        hashTable[extractJoinKey<keyArity>(tuple1, joinColumnIndexLength, relation1JoinColumnIndexArray)].push_back(&tuple1);
+    for (const auto& tuple2 : dataBuffer2) {
+        auto bucket = hashTable.find(extractJoinKey<keyArity>(tuple2, joinColumnIndexLength, relation2JoinColumnIndexArray));
+        if (bucket == hashTable.end())
+            continue;
+        for (const auto* tuple1 : bucket->second)
+            outputDataBuffer.insert(concatenateTuples<inputArity1, inputArity2>(*tuple1, tuple2));
+    }
+    outputRelation.setDataBuffer(outputDataBuffer);
+    return outputRelation;
+}
+
+/*
+ * Reports the allocations, allocated bytes and time of each operator on 1M-tuple TREE_STORAGE relations, and of the
+ * same operator with the previous API (previousApiSelection, ...), on the same relations.
+ */
+static void benchmarkOperatorAllocations() {
+    mt19937 generator(42);
+    const int tupleCount = 1000000;
+    auto inputRelation1 = generateRelation<3>(tupleCount, 0, UNIFORM, tupleCount, generator);
+    auto inputRelation2 = generateRelation<2>(tupleCount, 1, UNIFORM, tupleCount, generator);
+    auto smallRelation = generateRelation<2>(100, 0, UNIFORM, 100, generator);
+    auto crossProductInput = selection<3>(inputRelation1, 0, LESSTHAN, 10000);
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {1};
+    int projectionColumnIndex[2] = {2, 1};
+
+    auto compare = [&](const char* operatorName, auto now, auto previous) {
+        decltype(now()) nowOutput, previousOutput;
+        auto nowMeasurement = measureAllocations([&]() {nowOutput = now();});
+        auto previousMeasurement = measureAllocations([&]() {previousOutput = previous();});
+        cout << operatorName << ": " << nowMeasurement.allocations << " allocations, " << nowMeasurement.bytes / (1024 * 1024)
+             << " MB, " << nowMeasurement.milliseconds << " ms; previous API: " << previousMeasurement.allocations
+             << " allocations, " << previousMeasurement.bytes / (1024 * 1024) << " MB, " << previousMeasurement.milliseconds << " ms"
+             << (sameTuples(nowOutput, previousOutput) ? "" : " (OUTPUT MISMATCH)") << endl;
+    };
+
+    compare("selection", [&]() {return selection<3>(inputRelation1, 1, LESSTHAN, 1 << 29);},
+        [&]() {return previousApiSelection<3>(inputRelation1, 1, LESSTHAN, 1 << 29);});
+    compare("projection", [&]() {return projection<3, 2>(inputRelation1, projectionColumnIndex);},
+        [&]() {return previousApiProjection<3, 2>(inputRelation1, projectionColumnIndex);});
+    compare("crossProduct", [&]() {return crossProduct<3, 2>(crossProductInput, smallRelation);},
+        [&]() {return previousApiCrossProduct<3, 2>(crossProductInput, smallRelation);});
+    compare("equiJoinHash", [&]() {
+            return equiJoinHash<3, 2>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+        }, [&]() {
+            return previousApiEquiJoinHash<3, 2>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+        });
+}
+
+/*
+ * Runs selection -> projection -> equi-join on 1M-tuple relations once with the materializing operators and once as
+ * a pipelined plan, and compares time and peak heap memory (the input relations are not counted).
+ */
+static void benchmarkPipeline() {
+    mt19937 generator(42);
+    const int tupleCount = 1000000;
+    auto inputRelation1 = generateRelation<4>(tupleCount, 0, UNIFORM, tupleCount, generator);
+    auto inputRelation2 = generateRelation<2>(tupleCount / 10, 0, UNIFORM, tupleCount, generator);
+    int projectionColumnIndex[3] = {0, 1, 3};
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {0};
+
+    for (int storageMode : {TREE_STORAGE, FLAT_STORAGE}) {
+        inputRelation1.setStorageMode(storageMode);
+        inputRelation2.setStorageMode(storageMode);
+        relation<5> materializedOutput, pipelinedOutput;
+        auto materialized = measureAllocations([&]() {
+            auto selectionRelation = selection<4>(inputRelation1, 2, LESSTHAN, 1 << 29);
+            auto projectionRelation = projection<4, 3>(selectionRelation, projectionColumnIndex);
+            materializedOutput = equiJoinHash<3, 2>(projectionRelation, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+        });
+        auto pipelined = measureAllocations([&]() {
+            auto plan = planEquiJoin<3, 2>(
+                planProjection<4, 3>(planSelection<4>(planScan(inputRelation1), 2, LESSTHAN, 1 << 29), projectionColumnIndex),
+                planScan(inputRelation2), 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+            pipelinedOutput = executePlan<5>(move(plan), storageMode);
+        });
+        cout << (storageMode == FLAT_STORAGE ? "FLAT_STORAGE" : "TREE_STORAGE") << ": materialized "
+             << materialized.milliseconds << " ms, peak " << materialized.peakBytes / (1024 * 1024) << " MB; pipelined "
+             << pipelined.milliseconds << " ms, peak " << pipelined.peakBytes / (1024 * 1024) << " MB; output "
+             << pipelinedOutput.getTupleCount() << " tuples"
+             << (sameTuples(materializedOutput, pipelinedOutput) ? "" : " (OUTPUT MISMATCH)") << endl;
+    }
+}
+
+/*
+ * Computes the transitive closure of a random graph made of 200 separate 50-node DAGs (every node has up to 3 edges
+ * to one of the next 5 nodes) with transitiveClosure, and with the naive loop that joins the whole result with the
+ * edges until getTupleCount() stops changing (using equiJoinHash, equiJoinQuadratic would take hours).
+ */
+static void benchmarkTransitiveClosure() {
+    mt19937 generator(42);
+    const int componentCount = 200, componentSize = 50;
+    uniform_int_distribution<int> stepDistribution(1, 5);
+    tupleSet<2> edgeTuples;
+    for (int component = 0; component < componentCount; ++component) {
+        for (int i = 0; i < componentSize - 1; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                int target = min(i + stepDistribution(generator), componentSize - 1);
+                edgeTuples.insert({component * componentSize + i, component * componentSize + target});
+            }
+        }
+    }
+    relation<2> edges;
+    edges.setDataBuffer(move(edgeTuples));
+
+    relation<2> naiveOutput, semiNaiveOutput;
+    int iterationCount = 0;
+    double naiveTime = measureMilliseconds([&]() {
+        int joinColumnIndexRelation1[1] = {1};
+        int joinColumnIndexRelation2[1] = {0};
+        int projectionColumnIndex[2] = {0, 3};
+        naiveOutput = edges;
+        int previousTupleCount;
+        do {
+            previousTupleCount = naiveOutput.getTupleCount();
+            auto newPaths = projection<4, 2>(equiJoinHash<2, 2>(naiveOutput, edges, 1, joinColumnIndexRelation1, joinColumnIndexRelation2), projectionColumnIndex);
+            auto paths = naiveOutput.getDataBuffer();
+            paths.insert(newPaths.getDataBuffer().begin(), newPaths.getDataBuffer().end());
+            naiveOutput.setDataBuffer(move(paths));
+            ++iterationCount;
+        } while (naiveOutput.getTupleCount() != previousTupleCount);
+    });
+    double semiNaiveTime = measureMilliseconds([&]() {
+        semiNaiveOutput = transitiveClosure(edges);
+    });
+    cout << edges.getTupleCount() << " edges, " << semiNaiveOutput.getTupleCount() << " paths, " << iterationCount
+         << " iterations: naive " << naiveTime << " ms, semi-naive " << semiNaiveTime << " ms (speedup "
+         << naiveTime / semiNaiveTime << "x)"
+         << (sameTuples(naiveOutput, semiNaiveOutput) ? "" : " (OUTPUT MISMATCH)") << endl;
+}
+
+/*
+ * On a 1M-tuple relation, compares 1000 EQUAL selections on its second column without an index, with a HASH_INDEX and
+ * with a SORTED_INDEX, an equi-join of a 1000-tuple relation with it with and without an index, and loading the file
+ * with its saved index against loading it and building the index again.
+ */
+static void benchmarkIndexes() {
+    mt19937 generator(42);
+    const int tupleCount = 1000000, lookupCount = 1000;
+    auto indexedRelation = generateRelation<3>(tupleCount, 1, UNIFORM, tupleCount / 4, generator);
+    indexedRelation.setStorageMode(FLAT_STORAGE);
+    auto probeRelation = generateRelation<2>(1000, 0, UNIFORM, tupleCount / 4, generator);
+    uniform_int_distribution<int> keyDistribution(0, tupleCount / 4 - 1);
+    vector<int> lookupKeys(lookupCount);
+    for (int& key : lookupKeys)
+        key = keyDistribution(generator);
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {1};
+
+    const char* indexNames[3] = {"no index", "HASH_INDEX", "SORTED_INDEX"};
+    size_t referenceSelected = 0;
+    relation<5> referenceJoin;
+    for (int indexType : {-1, (int)HASH_INDEX, (int)SORTED_INDEX}) {
+        double buildTime = 0;
+        if (indexType < 0)
+            indexedRelation.dropIndex(1);
+        else
+            buildTime = measureMilliseconds([&]() {indexedRelation.buildIndex(1, indexType);});
+        size_t selected = 0;
+        double selectionTime = measureMilliseconds([&]() {
+            for (int key : lookupKeys)
+                selected += selection<3>(indexedRelation, 1, EQUAL, key).getTupleCount();
+        });
+        relation<5> joinOutput;
+        double joinTime = measureMilliseconds([&]() {
+            joinOutput = equiJoinHash<2, 3>(probeRelation, indexedRelation, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+        });
+        if (indexType < 0) {
+            referenceSelected = selected;
+            referenceJoin = joinOutput;
+        }
+        cout << indexNames[indexType + 1] << ": build " << buildTime << " ms, " << lookupCount << " selections "
+             << selectionTime << " ms, join " << joinTime << " ms"
+             << (selected == referenceSelected && sameTuples(joinOutput, referenceJoin) ? "" : " (OUTPUT MISMATCH)") << endl;
+    }
+
+    const char* filename = "benchmarkIndexInput";
+    indexedRelation.buildIndex(1, HASH_INDEX);
+    indexedRelation.saveToFile(filename);
+    relation<3> loadedRelation(FLAT_STORAGE);
+    double loadWithIndexTime = measureMilliseconds([&]() {loadedRelation.loadFromFile(filename);});
+    bool indexLoaded = loadedRelation.getIndex(1) != NULL;
+    indexedRelation.dropIndex(1);
+    indexedRelation.saveToFile(filename);
+    double loadAndBuildTime = measureMilliseconds([&]() {
+        loadedRelation.loadFromFile(filename);
+        loadedRelation.buildIndex(1, HASH_INDEX);
+    });
+    cout << "load with saved index " << loadWithIndexTime << " ms" << (indexLoaded ? "" : " (INDEX NOT LOADED)")
+         << ", load and rebuild index " << loadAndBuildTime << " ms" << endl;
+    remove(filename);
+}
+
+/*
+ * Saves two 1M-tuple relations raw and compressed: one with narrow columns (a sorted first column, values below 1000
+ * and below 100000 in the others) and one from generateRelation, whose last two columns are random 30-bit values.
+ * Compares the file sizes, the load times, and a selection that keeps 1% of the tuples by their first column, done
+ * by loading the raw file and by compressedSelection.
+ */
+static void benchmarkCompression() {
+    mt19937 generator(42);
+    const int tupleCount = 1000000;
+    uniform_int_distribution<int> keyDistribution(0, tupleCount - 1), smallDistribution(0, 999), mediumDistribution(0, 99999);
+    vector<array<int, 3>> narrowTuples(tupleCount);
+    for (auto& tuple : narrowTuples)
+        tuple = {keyDistribution(generator), smallDistribution(generator), mediumDistribution(generator)};
+    relation<3> narrowRelation;
+    narrowRelation.setFlatBuffer(move(narrowTuples));
+    auto randomRelation = generateRelation<3>(tupleCount, 0, UNIFORM, tupleCount, generator);
+
+    const char* rawFilename = "benchmarkCompressionRaw";
+    const char* compressedFilename = "benchmarkCompressionCompressed";
+    const char* roundTripFilename = "benchmarkCompressionRoundTrip";
+    for (int data = 0; data < 2; ++data) {
+        const relation<3>& inputRelation = (data == 0) ? narrowRelation : randomRelation;
+        inputRelation.saveToFile(rawFilename);
+        double compressTime = measureMilliseconds([&]() {convertRawToCompressed<3>(rawFilename, compressedFilename);});
+
+        FILE* pFile;
+        long fileSizes[2];
+        const char* filenames[2] = {rawFilename, compressedFilename};
+        for (int i = 0; i < 2; ++i) {
+            if (fopen_s(&pFile, filenames[i], "rb") != 0 || pFile == NULL)
+            {
+                fputs("File error", stderr);
+                exit(1);
+            }
+            fseek(pFile, 0, SEEK_END);
+            fileSizes[i] = ftell(pFile);
+            fclose(pFile);
+        }
+
+        relation<3> rawRelation, compressedRelation;
+        double rawLoadTime = measureMilliseconds([&]() {rawRelation = relation<3>(rawFilename, FLAT_STORAGE);});
+        double compressedLoadTime = measureMilliseconds([&]() {compressedRelation = loadCompressedFile<3>(compressedFilename, FLAT_STORAGE);});
+
+        predicate condition = {0, LESSTHAN, tupleCount / 100};
+        relation<3> rawSelected, compressedSelected;
+        size_t bytesRead = 0;
+        double rawSelectionTime = measureMilliseconds([&]() {
+            rawSelected = selection<3>(relation<3>(rawFilename, FLAT_STORAGE), &condition, 1, CONJUNCTION);
+        });
+        double compressedSelectionTime = measureMilliseconds([&]() {
+            compressedSelected = compressedSelection<3>(compressedFilename, &condition, 1, CONJUNCTION, FLAT_STORAGE, &bytesRead);
+        });
+
+        convertCompressedToRaw<3>(compressedFilename, roundTripFilename);
+        relation<3> roundTripRelation(roundTripFilename, FLAT_STORAGE);
+        bool outputsMatch = compressedRelation.getFlatBuffer() == rawRelation.getFlatBuffer()
+                         && roundTripRelation.getFlatBuffer() == rawRelation.getFlatBuffer()
+                         && compressedSelected.getFlatBuffer() == rawSelected.getFlatBuffer();
+
+        cout << (data == 0 ? "narrow columns" : "random columns") << ": raw " << fileSizes[0] / 1024 << " KB, compressed "
+             << fileSizes[1] / 1024 << " KB (" << (double)fileSizes[0] / fileSizes[1] << "x, " << compressTime << " ms); load raw "
+             << rawLoadTime << " ms, compressed " << compressedLoadTime << " ms; 1% selection raw " << rawSelectionTime
+             << " ms, compressed " << compressedSelectionTime << " ms reading " << bytesRead / 1024 << " KB"
+             << (outputsMatch ? "" : " (OUTPUT MISMATCH)") << endl;
+    }
+    remove(rawFilename);
+    remove(compressedFilename);
+    remove(roundTripFilename);
+}
+
+/*
+ * Writes a 4M-tuple raw file, and runs selection -> projection and an equi-join probed by the file once by loading
+ * the file with FLAT_STORAGE and once streaming it (planFileScan + executePlanToFile with a 256K-tuple sort budget),
+ * and compares time and peak heap memory.
+ */
+static void benchmarkStreaming() {
+    mt19937 generator(42);
+    const int tupleCount = 4000000;
+    const size_t memoryBudgetTuples = 1 << 18;
+    const char* inputFilename = "benchmarkStreamingInput";
+    const char* outputFilename = "benchmarkStreamingOutput";
+    generateRelation<3>(tupleCount, 0, UNIFORM, tupleCount, generator).saveToFile(inputFilename);
+    auto buildRelation = generateRelation<2>(10000, 0, UNIFORM, tupleCount, generator);
+    int projectionColumnIndex[2] = {0, 2};
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {0};
+
+    for (int query = 0; query < 2; ++query) {
+        size_t loadedTupleCount = 0, streamedTupleCount = 0;
+        bool outputsMatch = true;
+        auto loaded = measureAllocations([&]() {
+            relation<3> inputRelation(inputFilename, FLAT_STORAGE);
+            if (query == 0) {
+                auto outputRelation = projection<3, 2>(selection<3>(inputRelation, 1, LESSTHAN, 1 << 29), projectionColumnIndex);
+                loadedTupleCount = outputRelation.getTupleCount();
+                outputRelation.saveToFile(outputFilename);
+            }
+            else {
+                auto outputRelation = equiJoinHash<3, 2>(inputRelation, buildRelation, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+                loadedTupleCount = outputRelation.getTupleCount();
+                outputRelation.saveToFile(outputFilename);
+            }
+        });
+        relation<2> loadedProjection;
+        relation<5> loadedJoin;
+        if (query == 0)
+            loadedProjection = relation<2>(outputFilename, FLAT_STORAGE);
+        else
+            loadedJoin = relation<5>(outputFilename, FLAT_STORAGE);
+
+        auto streamed = measureAllocations([&]() {
+            if (query == 0)
+                streamedTupleCount = executePlanToFile<2>(planProjection<3, 2>(
+                    planSelection<3>(planFileScan<3>(inputFilename), 1, LESSTHAN, 1 << 29), projectionColumnIndex),
+                    outputFilename, memoryBudgetTuples);
+            else
+                streamedTupleCount = executePlanToFile<5>(planEquiJoin<3, 2>(planFileScan<3>(inputFilename), planScan(buildRelation),
+                    1, joinColumnIndexRelation1, joinColumnIndexRelation2), outputFilename, memoryBudgetTuples);
+        });
+        if (query == 0)
+            outputsMatch = relation<2>(outputFilename, FLAT_STORAGE).getFlatBuffer() == loadedProjection.getFlatBuffer();
+        else
+            outputsMatch = relation<5>(outputFilename, FLAT_STORAGE).getFlatBuffer() == loadedJoin.getFlatBuffer();
+
+        cout << (query == 0 ? "selection -> projection" : "equi-join probed by the file") << ": loaded "
+             << loaded.milliseconds << " ms, peak " << loaded.peakBytes / (1024 * 1024) << " MB; streamed "
+             << streamed.milliseconds << " ms, peak " << streamed.peakBytes / (1024 * 1024) << " MB; output "
+             << streamedTupleCount << " tuples"
+             << (outputsMatch && loadedTupleCount == streamedTupleCount ? "" : " (OUTPUT MISMATCH)") << endl;
+    }
+    remove(inputFilename);
+    remove(outputFilename);
+}
+
+/*
+ * Runs selection, projection and equi-join on the same 1M-tuple relations as relation<arity> (FLAT_STORAGE) and as
+ * dynamicRelation, and compares the times. Also runs the projection with a 10-arity relation, which dynamicRelation
+ * sorts with the generic row comparison.
+ */
+static void benchmarkDynamicRelation() {
+    mt19937 generator(42);
+    const int tupleCount = 1000000;
+    auto staticRelation1 = generateRelation<3>(tupleCount, 0, UNIFORM, tupleCount, generator);
+    auto staticRelation2 = generateRelation<2>(tupleCount / 10, 0, UNIFORM, tupleCount, generator);
+    auto staticRelationWide = generateRelation<10>(tupleCount / 4, 0, UNIFORM, 1000, generator);
+    staticRelation1.setStorageMode(FLAT_STORAGE);
+    staticRelation2.setStorageMode(FLAT_STORAGE);
+    staticRelationWide.setStorageMode(FLAT_STORAGE);
+    auto dynamicRelation1 = toDynamicRelation(staticRelation1);
+    auto dynamicRelation2 = toDynamicRelation(staticRelation2);
+    auto dynamicRelationWide = toDynamicRelation(staticRelationWide);
+    int projectionColumnIndex[2] = {1, 2};
+    int wideProjectionColumnIndex[9] = {0, 2, 3, 4, 5, 6, 7, 8, 9};
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {0};
+
+    relation<3> staticSelected;
+    relation<2> staticProjected;
+    relation<9> staticWideProjected;
+    relation<5> staticJoined;
+    dynamicRelation dynamicSelected, dynamicProjected, dynamicWideProjected, dynamicJoined;
+    double times[2][4];
+    times[0][0] = measureMilliseconds([&]() {staticSelected = selection<3>(staticRelation1, 1, LESSTHAN, 1 << 29);});
+    times[1][0] = measureMilliseconds([&]() {dynamicSelected = selection(dynamicRelation1, 1, LESSTHAN, 1 << 29);});
+    times[0][1] = measureMilliseconds([&]() {staticProjected = projection<3, 2>(staticRelation1, projectionColumnIndex);});
+    times[1][1] = measureMilliseconds([&]() {dynamicProjected = projection(dynamicRelation1, projectionColumnIndex, 2);});
+    times[0][2] = measureMilliseconds([&]() {staticWideProjected = projection<10, 9>(staticRelationWide, wideProjectionColumnIndex);});
+    times[1][2] = measureMilliseconds([&]() {dynamicWideProjected = projection(dynamicRelationWide, wideProjectionColumnIndex, 9);});
+    times[0][3] = measureMilliseconds([&]() {
+        staticJoined = equiJoinHash<3, 2>(staticRelation1, staticRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+    });
+    times[1][3] = measureMilliseconds([&]() {
+        dynamicJoined = equiJoinHash(dynamicRelation1, dynamicRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+    });
+
+    bool outputsMatch[4] = {
+        toStaticRelation<3>(dynamicSelected).getFlatBuffer() == staticSelected.getFlatBuffer(),
+        toStaticRelation<2>(dynamicProjected).getFlatBuffer() == staticProjected.getFlatBuffer(),
+        toStaticRelation<9>(dynamicWideProjected).getFlatBuffer() == staticWideProjected.getFlatBuffer(),
+        toStaticRelation<5>(dynamicJoined).getFlatBuffer() == staticJoined.getFlatBuffer()
+    };
+    const char* operatorNames[4] = {"selection", "projection", "projection of a 10-arity relation", "equi-join"};
+    for (int i = 0; i < 4; ++i) {
+        cout << operatorNames[i] << ": relation<arity> " << times[0][i] << " ms, dynamicRelation " << times[1][i]
+             << " ms (" << times[1][i] / times[0][i] << "x)" << (outputsMatch[i] ? "" : " (OUTPUT MISMATCH)") << endl;
+    }
+}
+
+/*
+ * A 4-way chain join A(x, y) - B(y, z) - C(z, w) - D(w, v) where A and B share only 5 values of y, so joining them
+ * first (the written order) builds a 5M-tuple intermediate, while C is small and selective. Runs the written order
+ * and multiWayJoin (the cost-based order), prints both plans and checks that multiWayJoin returns the same tuples.
+ */
+static void benchmarkJoinOrder() {
+    mt19937 generator(42);
+    uniform_int_distribution<int> valueDistribution(0, 1 << 30), fewDistribution(0, 4), wDistribution(0, 99);
+    vector<int> dataA, dataB, dataC, dataD;
+    for (int i = 0; i < 5000; ++i) {
+        dataA.insert(dataA.end(), {valueDistribution(generator), fewDistribution(generator)});
+        dataB.insert(dataB.end(), {fewDistribution(generator), valueDistribution(generator)});
+    }
+    for (int i = 0; i < 50; ++i)
+        dataC.insert(dataC.end(), {dataB[2 * (valueDistribution(generator) % 5000) + 1], wDistribution(generator)});
+    for (int i = 0; i < 1000; ++i)
+        dataD.insert(dataD.end(), {wDistribution(generator), valueDistribution(generator)});
+    dynamicRelation relationA(2), relationB(2), relationC(2), relationD(2);
+    relationA.setData(move(dataA));
+    relationB.setData(move(dataB));
+    relationC.setData(move(dataC));
+    relationD.setData(move(dataD));
+
+    vector<const dynamicRelation*> relations = {&relationA, &relationB, &relationC, &relationD};
+    vector<joinCondition> conditions = {{0, 1, 1, 0}, {1, 1, 2, 0}, {2, 1, 3, 0}};
+    dynamicRelation writtenOrderOutput, costBasedOutput;
+    vector<joinPlanStep> writtenOrderPlan;
+    double writtenOrderTime = measureMilliseconds([&]() {
+        writtenOrderPlan = planMultiWayJoin(relations, conditions, false);
+        writtenOrderOutput = executeMultiWayJoin(relations, conditions, writtenOrderPlan);
+    });
+    cout << "written order: " << writtenOrderTime << " ms, output " << writtenOrderOutput.getTupleCount() << " tuples" << endl;
+    explainMultiWayJoin(writtenOrderPlan);
+
+    // multiWayJoin prints its plan once it has run
+    cout << "cost-based order (multiWayJoin):" << endl;
+    double costBasedTime = measureMilliseconds([&]() {costBasedOutput = multiWayJoin(relations, conditions, true);});
+    cout << "multiWayJoin: " << costBasedTime << " ms, output " << costBasedOutput.getTupleCount() << " tuples"
+         << (costBasedOutput.getData() == writtenOrderOutput.getData() ? "" : " (OUTPUT MISMATCH)") << endl;
+}
+
+/*
+ * Finds the triangles (a, b, c with edges a -> b, b -> c and a -> c) of a random graph whose node degrees are skewed
+ * (Zipf-like, s = 0.5), with two chained pairwise hash joins (which build every path a -> b -> c) and with
+ * leapfrogTriejoin, and checks that both return the same (a, b, c) tuples.
+ */
+static void benchmarkTriangles() {
+    mt19937 generator(42);
+    const int nodeCount = 50000, edgeCount = 200000;
+    vector<double> nodeWeights(nodeCount);
+    for (int i = 0; i < nodeCount; ++i)
+        nodeWeights[i] = 1.0 / sqrt(i + 1.0);
+    discrete_distribution<int> nodeDistribution(nodeWeights.begin(), nodeWeights.end());
+    tupleSet<2> edgeTuples;
+    while ((int)edgeTuples.size() < edgeCount) {
+        int source = nodeDistribution(generator), target = nodeDistribution(generator);
+        if (source != target)
+            edgeTuples.insert({source, target});
+    }
+    relation<2> edges;
+    edges.setDataBuffer(move(edgeTuples));
+    auto dynamicEdges = toDynamicRelation(edges);
+
+    int pathCount = 0;
+    relation<6> pairwiseTriangles;
+    double pairwiseTime = measureMilliseconds([&]() {
+        int joinColumnIndexRelation1[1] = {1};
+        int joinColumnIndexRelation2[1] = {0};
+        auto paths = equiJoinHash<2, 2>(edges, edges, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+        pathCount = paths.getTupleCount();
+        int closingColumnIndexRelation1[2] = {0, 3};
+        int closingColumnIndexRelation2[2] = {0, 1};
+        pairwiseTriangles = equiJoinHash<4, 2>(paths, edges, 2, closingColumnIndexRelation1, closingColumnIndexRelation2);
+    });
+    dynamicRelation leapfrogTriangles;
+    double leapfrogTime = measureMilliseconds([&]() {
+        vector<const dynamicRelation*> relations = {&dynamicEdges, &dynamicEdges, &dynamicEdges};
+        leapfrogTriangles = leapfrogTriejoin(relations, {{0, 1}, {1, 2}, {0, 2}}, {0, 1, 2});
+    });
+
+    // The pairwise tuples are (a, b, b, c, a, c). The variable order is sorted, so the leapfrog output is marked
+    // sorted without sorting it again, and sameTuples compares it in place
+    int triangleColumns[3] = {0, 1, 3};
+    bool outputsMatch = sameTuples(projection<6, 3>(pairwiseTriangles, triangleColumns), toStaticRelation<3>(leapfrogTriangles));
+    cout << edgeCount << " edges: pairwise joins " << pairwiseTime << " ms (" << pathCount << " intermediate paths), "
+         << "leapfrog triejoin " << leapfrogTime << " ms (speedup " << pairwiseTime / leapfrogTime << "x), "
+         << leapfrogTriangles.getTupleCount() << " triangles" << (outputsMatch ? "" : " (OUTPUT MISMATCH)") << endl;
+}
+
+/*
+ * Runs selection -> projection -> equi-join -> selection on 1M-tuple TREE_STORAGE relations with the tuple sets and
+ * hash tables allocated from the heap, from a POOL_ARENA and from a MONOTONIC_ARENA, and reports the heap allocations
+ * of every operator and the time of the whole query (including freeing its intermediate relations).
+ */
+static void benchmarkArena() {
+    mt19937 generator(42);
+    const int tupleCount = 1000000;
+    auto inputRelation1 = generateRelation<4>(tupleCount, 0, UNIFORM, tupleCount, generator);
+    auto inputRelation2 = generateRelation<2>(tupleCount, 0, UNIFORM, tupleCount, generator);
+    int projectionColumnIndex[3] = {0, 1, 3};
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {0};
+
+    relation<5> heapOutput;
+    for (int arenaType : {-1, (int)POOL_ARENA, (int)MONOTONIC_ARENA}) {
+        relation<5> output;
+        allocationMeasurement selectionAllocations, projectionAllocations, joinAllocations, resultAllocations;
+        auto query = measureAllocations([&]() {
+            unique_ptr<queryArena> arena(arenaType < 0 ? NULL : new queryArena(arenaType));
+            relation<4> selectionRelation;
+            relation<3> projectionRelation;
+            relation<5> joinRelation;
+            selectionAllocations = measureAllocations([&]() {selectionRelation = selection<4>(inputRelation1, 2, LESSTHAN, 1 << 30);});
+            projectionAllocations = measureAllocations([&]() {projectionRelation = projection<4, 3>(selectionRelation, projectionColumnIndex);});
+            joinAllocations = measureAllocations([&]() {
+                joinRelation = equiJoinHash<3, 2>(projectionRelation, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+            });
+            // output was declared before the arena, so assigning to it copies the result to the heap
+            resultAllocations = measureAllocations([&]() {output = selection<5>(joinRelation, 4, LESSTHAN, 1 << 30);});
+        });
+        cout << (arenaType < 0 ? "heap" : arenaType == POOL_ARENA ? "POOL_ARENA" : "MONOTONIC_ARENA") << ": selection "
+             << selectionAllocations.allocations << ", projection " << projectionAllocations.allocations << ", equiJoinHash "
+             << joinAllocations.allocations << ", selection " << resultAllocations.allocations << " allocations; query "
+             << query.milliseconds << " ms, peak " << query.peakBytes / (1024 * 1024) << " MB; output " << output.getTupleCount()
+             << " tuples";
+        if (arenaType < 0)
+            heapOutput = output;
+        else if (!sameTuples(heapOutput, output))
+            cout << " (OUTPUT MISMATCH)";
+        cout << endl;
+    }
+}
+
+/*
+ * Measures the cost of the operator profiles: 1M selections on a 16-tuple relation (where the cost of an operator
+ * call matters most) and a load -> selection -> projection -> join -> save query on 1M tuples, with profiling
+ * disabled and enabled. The profiles of the query are written to benchmarkProfile.json and benchmarkProfile.trace.json.
+ *
+ *  Note:
+ *          The cost of the disabled hooks is the "disabled" line of this build minus the "compiled out" line of a
+ *          build with RELATIONAL_ALGEBRA_NO_PROFILING defined, which only runs without the hooks
+ *          The allocation counts are only measured with RELATIONAL_ALGEBRA_COUNT_ALLOCATIONS, which also slows
+ *          down every allocation, so the hooks are best compared in builds without it
+ */
+static void benchmarkProfiling() {
+    mt19937 generator(42);
+    const int tupleCount = 1000000, callCount = 1000000;
+    auto smallRelation = generateRelation<3>(16, 0, UNIFORM, 100, generator);
+    smallRelation.setStorageMode(FLAT_STORAGE);
+    generateRelation<4>(tupleCount, 0, UNIFORM, tupleCount, generator).saveToFile("benchmarkProfileInput");
+    auto inputRelation2 = generateRelation<2>(tupleCount, 0, UNIFORM, tupleCount, generator);
+    int projectionColumnIndex[3] = {0, 1, 3};
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {0};
+
+    for (bool enabled : {false, true}) {
+        if (enabled && !profilingCompiled)
+            break;
+        enableProfiling(enabled);
+        clearProfiles();
+        int selectedTuples = 0;
+        double callTime = measureMilliseconds([&]() {
+            for (int i = 0; i < callCount; ++i)
+                selectedTuples += selection<3>(smallRelation, 0, LESSTHAN, i % 100).getTupleCount();
+        });
+        clearProfiles();
+        double queryTime = measureMilliseconds([&]() {
+            relation<4> inputRelation1("benchmarkProfileInput", FLAT_STORAGE);
+            auto selectionRelation = selection<4>(inputRelation1, 2, LESSTHAN, 1 << 30);
+            auto projectionRelation = projection<4, 3>(selectionRelation, projectionColumnIndex);
+            equiJoinHash<3, 2>(projectionRelation, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2)
+                .saveToFile("benchmarkProfileOutput");
+        });
+        cout << "profiling " << (enabled ? "enabled" : profilingCompiled ? "disabled" : "compiled out") << ": " << callTime * 1e6 / callCount
+             << " ns per selection call (" << selectedTuples << " tuples), query " << queryTime << " ms" << endl;
+        if (enabled) {
+            for (const auto& profile : getProfiles())
+                cout << "  " << profile.operatorName << ": " << profile.durationMicroseconds / 1000 << " ms, "
+                     << profile.inputTuples << " -> " << profile.outputTuples << " tuples, " << profile.bytesRead / (1024 * 1024)
+                     << " MB read, " << profile.bytesWritten / (1024 * 1024) << " MB written, " << profile.allocations
+                     << " allocations, peak " << profile.peakBytes / (1024 * 1024) << " MB" << endl;
+            exportProfileJson("benchmarkProfile.json");
+            exportChromeTrace("benchmarkProfile.trace.json");
+        }
     }
+    enableProfiling(false);
+    clearProfiles();
+    remove("benchmarkProfileInput");
+    remove("benchmarkProfileOutput");
+}
 
-    tupleCount = dataBuffer.size();
+/*
+ * Benchmark suite
+ *
+ * runBenchmarkSuite times the operators on synthetic files (generateRelationFile) of 10^3, 10^4, ... up to
+ * maxTupleCount tuples, of arity 2, 4 and 8, and prints (and writes to resultsFilename, if not NULL) one CSV row
+ * per measurement:
+ *  operator,distribution,arity,tuples,outputTuples,milliseconds,allocations,peakBytes
+ * The operators are loadFromFile in each storage mode and saveToFile, selection and projection, crossProduct with
+ * a 16-tuple relation, and equiJoinHash, equiJoinSortMerge and equiJoinQuadratic on uniform keys, Zipf keys (joined
+ * with uniform keys), duplicate keys (the join is a cross product, like case 1, of at most SUITE_DUPLICATE_TUPLES
+ * tuples per input) and disjoint keys (no output, like case 2). The files are generated with fixed seeds, so every run measures the same data, and the CSV files of two
+ * runs can be compared with compareBenchmarkResults.
+ *
+ *  For example:
+ *      relationalAlgebra --suite 100000000 results.csv baseline.csv -- runs the suite up to 10^8 tuples, writes
+ *                                                  results.csv and exits with 1 if an operator got slower
+ *
+ *  Note:
+ *          milliseconds is the fastest of SUITE_REPETITIONS runs (a single run above 10^6 tuples), it includes
+ *          freeing the output relation
+ *          The operators run on FLAT_STORAGE relations. TREE_STORAGE is only loaded up to SUITE_TREE_LIMIT tuples,
+ *          crossProduct is skipped if its output (16 times its input) would exceed SUITE_OUTPUT_LIMIT tuples, the
+ *          joins if their output would exceed both SUITE_OUTPUT_LIMIT tuples and the input size, and
+ *          equiJoinQuadratic if it would compare more than SUITE_QUADRATIC_LIMIT pairs of tuples
+ *          The duplicate key joins run on inputs of min(tuples, SUITE_DUPLICATE_TUPLES) tuples, so their output
+ *          stays under SUITE_OUTPUT_LIMIT tuples. The tuples column of their rows is that input size, and they only
+ *          run up to the first suite size that reaches SUITE_DUPLICATE_TUPLES, so no two rows measure the same inputs
+ */
+static const int SUITE_REPETITIONS = 3;
+static const long long SUITE_TREE_LIMIT = 10000000;
+static const long long SUITE_OUTPUT_LIMIT = 10000000;
+static const long long SUITE_QUADRATIC_LIMIT = 100000000;
+// sqrt(SUITE_OUTPUT_LIMIT)
+static const long long SUITE_DUPLICATE_TUPLES = 3162;
 
-    // ͷŻ
-    free(buffer);
+struct suiteResult
+{
+    string operatorName;
+    string distribution;
+    int arity;
+    long long tupleCount;
+    long long outputTuples;
+    double milliseconds;
+    size_t allocations;
+    size_t peakBytes;
+};
+
+static const char* SUITE_CSV_HEADER = "operator,distribution,arity,tuples,outputTuples,milliseconds,allocations,peakBytes";
+
+static string formatSuiteResult(const suiteResult& result) {
+    char row[256];
+    snprintf(row, sizeof(row), "%s,%s,%d,%lld,%lld,%.3f,%zu,%zu", result.operatorName.c_str(), result.distribution.c_str(),
+        result.arity, result.tupleCount, result.outputTuples, result.milliseconds, result.allocations, result.peakBytes);
+    return row;
 }
 
+// Runs function (which returns the number of output tuples) and appends its fastest run to results
+template <class F>
+static void measureSuiteOperator(vector<suiteResult>& results, const string& operatorName, const char* distribution,
+    int arity, long long tupleCount, F function) {
+    suiteResult result = {operatorName, distribution, arity, tupleCount, 0, 0, 0, 0};
+    int repetitions = tupleCount <= 1000000 ? SUITE_REPETITIONS : 1;
+    for (int i = 0; i < repetitions; ++i) {
+        long long outputTuples = 0;
+        auto measurement = measureAllocations([&]() {outputTuples = function();});
+        if (i == 0 || measurement.milliseconds < result.milliseconds) {
+            result.outputTuples = outputTuples;
+            result.milliseconds = measurement.milliseconds;
+            result.allocations = measurement.allocations;
+            result.peakBytes = measurement.peakBytes;
+        }
+    }
+    results.push_back(result);
+    cout << formatSuiteResult(result) << endl;
+}
 
+template <size_t arity>
+static void runSuiteJoins(vector<suiteResult>& results, const char* distribution, long long tupleCount,
+    const relation<arity>& inputRelation1, const relation<arity>& inputRelation2, long long expectedOutputTuples) {
+    if (expectedOutputTuples > SUITE_OUTPUT_LIMIT && expectedOutputTuples > tupleCount)
+        return;
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {0};
+    measureSuiteOperator(results, "equiJoinHash", distribution, arity, tupleCount, [&]() {
+        return (long long)equiJoinHash<arity, arity>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1,
+            joinColumnIndexRelation2).getTupleCount();
+    });
+    measureSuiteOperator(results, "equiJoinSortMerge", distribution, arity, tupleCount, [&]() {
+        return (long long)equiJoinSortMerge<arity, arity>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1,
+            joinColumnIndexRelation2).getTupleCount();
+    });
+    if ((long long)inputRelation1.getTupleCount() * inputRelation2.getTupleCount() <= SUITE_QUADRATIC_LIMIT)
+        measureSuiteOperator(results, "equiJoinQuadratic", distribution, arity, tupleCount, [&]() {
+            return (long long)equiJoinQuadratic<arity, arity>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1,
+                joinColumnIndexRelation2).getTupleCount();
+        });
+}
 
 template <size_t arity>
-void relation<arity>::saveToFile(const char* filename)
-{
-    FILE* pFile;
+static void runSuiteArity(vector<suiteResult>& results, long long tupleCount) {
+    constexpr size_t projectionArity = (arity + 1) / 2;
+    const char* storageModeNames[3] = {"TREE_STORAGE", "FLAT_STORAGE", "MAPPED_STORAGE"};
+    string prefix = "benchmarkSuite" + to_string(arity);
+    string uniformFile1 = prefix + "Uniform1", uniformFile2 = prefix + "Uniform2", zipfFile = prefix + "Zipf";
+    string disjointFile = prefix + "Disjoint", duplicateFile1 = prefix + "Duplicate1", duplicateFile2 = prefix + "Duplicate2";
+    string smallFile = prefix + "Small", outputFile = prefix + "Output";
+    int keyRange = (int)tupleCount;
+    long long duplicateTupleCount = min(tupleCount, SUITE_DUPLICATE_TUPLES);
+    generateRelationFile(uniformFile1.c_str(), arity, tupleCount, 0, UNIFORM, 0, keyRange, 1);
+    generateRelationFile(uniformFile2.c_str(), arity, tupleCount, 0, UNIFORM, 0, keyRange, 2);
+    generateRelationFile(zipfFile.c_str(), arity, tupleCount, 0, SKEWED, 0, keyRange, 3);
+    generateRelationFile(disjointFile.c_str(), arity, tupleCount, 0, UNIFORM, keyRange, keyRange, 4);
+    generateRelationFile(smallFile.c_str(), arity, 16, 0, UNIFORM, 0, 16, 5);
+    // The suite sizes grow 10 times, so the previous size had all the duplicate key tuples if it was at least as large
+    bool runDuplicateJoins = tupleCount / 10 < SUITE_DUPLICATE_TUPLES;
+    if (runDuplicateJoins) {
+        generateRelationFile(duplicateFile1.c_str(), arity, duplicateTupleCount, 0, DUPLICATE_KEY, 5, 1, 6);
+        generateRelationFile(duplicateFile2.c_str(), arity, duplicateTupleCount, 0, DUPLICATE_KEY, 5, 1, 7);
+    }
 
-    // ʹ fopen_s ļעһ FILE* ָ
-    errno_t err = fopen_s(&pFile, filename, "wb");
-    if (err != 0 || pFile == NULL)
-    {
-        fputs("File error", stderr);
-        exit(1);
+    for (int storageMode : {TREE_STORAGE, FLAT_STORAGE, MAPPED_STORAGE}) {
+        if (storageMode == TREE_STORAGE && tupleCount > SUITE_TREE_LIMIT)
+            continue;
+        measureSuiteOperator(results, string("loadFromFile/") + storageModeNames[storageMode], "uniform", arity, tupleCount, [&]() {
+            return (long long)relation<arity>(uniformFile1.c_str(), storageMode).getTupleCount();
+        });
     }
 
-    //  dataBuffer ݽṹд뵽
-    for (const auto& tuple : dataBuffer)  // ʹԱⲻҪĿ
-    {
-        int temp[arity];
-        for (int i = 0; i < arity; i++)
-            temp[i] = tuple[i];
-        fwrite(temp, sizeof(int), arity, pFile);
+    relation<arity> uniformRelation1(uniformFile1.c_str(), FLAT_STORAGE), uniformRelation2(uniformFile2.c_str(), FLAT_STORAGE);
+    relation<arity> zipfRelation(zipfFile.c_str(), FLAT_STORAGE), disjointRelation(disjointFile.c_str(), FLAT_STORAGE);
+    relation<arity> smallRelation(smallFile.c_str(), FLAT_STORAGE);
+    measureSuiteOperator(results, "saveToFile", "uniform", arity, tupleCount, [&]() {
+        uniformRelation1.saveToFile(outputFile.c_str());
+        return (long long)uniformRelation1.getTupleCount();
+    });
+    measureSuiteOperator(results, "selection", "uniform", arity, tupleCount, [&]() {
+        return (long long)selection<arity>(uniformRelation1, 0, LESSTHAN, keyRange / 2).getTupleCount();
+    });
+    measureSuiteOperator(results, "selection", "zipf", arity, tupleCount, [&]() {
+        return (long long)selection<arity>(zipfRelation, 0, EQUAL, 0).getTupleCount();
+    });
+    int projectionColumnIndex[projectionArity];
+    for (size_t i = 0; i < projectionArity; ++i)
+        projectionColumnIndex[i] = (int)(2 * i);
+    measureSuiteOperator(results, "projection", "uniform", arity, tupleCount, [&]() {
+        return (long long)projection<arity, projectionArity>(uniformRelation1, projectionColumnIndex).getTupleCount();
+    });
+    if (16 * tupleCount <= SUITE_OUTPUT_LIMIT)
+        measureSuiteOperator(results, "crossProduct", "uniform", arity, tupleCount, [&]() {
+            return (long long)crossProduct<arity, arity>(uniformRelation1, smallRelation).getTupleCount();
+        });
+
+    // A join on uniform or Zipf keys with uniform keys outputs about tupleCount tuples
+    runSuiteJoins<arity>(results, "uniform", tupleCount, uniformRelation1, uniformRelation2, tupleCount);
+    runSuiteJoins<arity>(results, "zipf", tupleCount, zipfRelation, uniformRelation2, tupleCount);
+    runSuiteJoins<arity>(results, "nomatch", tupleCount, uniformRelation1, disjointRelation, 0);
+    if (runDuplicateJoins) {
+        relation<arity> duplicateRelation1(duplicateFile1.c_str(), FLAT_STORAGE), duplicateRelation2(duplicateFile2.c_str(), FLAT_STORAGE);
+        runSuiteJoins<arity>(results, "duplicate", duplicateTupleCount, duplicateRelation1, duplicateRelation2,
+            duplicateTupleCount * duplicateTupleCount);
     }
 
-    // رļ
-    fclose(pFile);
+    for (const string& filename : {uniformFile1, uniformFile2, zipfFile, disjointFile, duplicateFile1, duplicateFile2, smallFile, outputFile})
+        remove(filename.c_str());
 }
 
-template <size_t arity>
-relation<arity>::relation(const char *filename)
-{
-    loadFromFile(filename);
-}
+static vector<suiteResult> runBenchmarkSuite(long long maxTupleCount, const char* resultsFilename) {
+    vector<suiteResult> results;
+    cout << SUITE_CSV_HEADER << endl;
+    for (long long tupleCount = 1000; tupleCount <= maxTupleCount; tupleCount *= 10) {
+        runSuiteArity<2>(results, tupleCount);
+        runSuiteArity<4>(results, tupleCount);
+        runSuiteArity<8>(results, tupleCount);
+    }
 
-template <size_t arity>
-void relation<arity>::printRelation()
-{
-    cout << "Number of tuples in the relation: " << dataBuffer.size() << endl;
-    
-    // Note there are many ways of iterating through the set data structure
-    // Method 1
-    auto it = dataBuffer.begin();
-    for (int i = 0; i < dataBuffer.size(); i++)
-    {
-        std::array<int, arity> arr = *it;
-        for (int j=0; j < arity; j++)
+    if (resultsFilename != NULL) {
+        FILE* pFile;
+        errno_t err = fopen_s(&pFile, resultsFilename, "w");
+        if (err != 0 || pFile == NULL)
         {
-            if (j < arity-1)
-                cout << arr[j] << " ";
-            else
-                cout << arr[j] << endl;
+            fputs("File error", stderr);
+            exit(1);
         }
-        it++;
+        fprintf(pFile, "%s\n", SUITE_CSV_HEADER);
+        for (const auto& result : results)
+            fprintf(pFile, "%s\n", formatSuiteResult(result).c_str());
+        fclose(pFile);
     }
+    return results;
+}
 
-    // Method 2 (I showed this method in the class)
-    for (const auto& tuple : dataBuffer)
+static vector<suiteResult> loadBenchmarkResults(const char* filename) {
+    FILE* pFile;
+    errno_t err = fopen_s(&pFile, filename, "r");
+    if (err != 0 || pFile == NULL)
     {
-        for (int j=0; j < arity; j++)
-        {
-            //if (j < arity-1)
-            //    cout << tuple[j] << " ";
-            //else
-            //    cout << tuple[j] << endl;
-        }
+        fputs("File error", stderr);
+        exit(1);
+    }
+    vector<suiteResult> results;
+    char row[256], operatorName[128], distribution[64];
+    suiteResult result;
+    while (fgets(row, sizeof(row), pFile) != NULL) {
+        if (sscanf(row, "%127[^,],%63[^,],%d,%lld,%lld,%lf,%zu,%zu", operatorName, distribution, &result.arity,
+                &result.tupleCount, &result.outputTuples, &result.milliseconds, &result.allocations, &result.peakBytes) != 8)
+            continue;  // the header
+        result.operatorName = operatorName;
+        result.distribution = distribution;
+        results.push_back(result);
     }
+    fclose(pFile);
+    return results;
 }
 
-
-
 /*
- * Template parameters:
- *  arity - the arity of both input and output relation
- *   
- * Function parameters: 
- *  inputRelation: this is the input relation on which the selection operation will be applied
- *  attributeIndex: it is the index of the attribute column on which the selection operation is to be applied
- *  operation: it can be EQUAL or LESSTHAN or GREATERTHAN
- *  operand: it the the value against which the attribute value is compared with using the "operation".
- * 
- *  For example:
- *      selection<2>(rel2Arity, 1, GREATERTHAN, 500) -- rel2Arity is a 2-arity (i.e. 2 columns) relation, 
- *                                                  on which we are applying the selection condition 
- *                                                  on the second column, and we keep a row/tuple if the
- *                                                  second column value is greater than 500
- *      selection<4>(rel4Arity, 3, EQUAL, 200) -- rel4Arity is a 4-arity (i.e. 4 columns) relation, 
- *                                                  on which we are applying the selection condition 
- *                                                  on the fourth column, and we keep a row/tuple if the
- *                                                  fourth column value is equal to 200
- * 
- *  Note:
- *          The arity of the input and outpur relations are the same, therefore the template has only one arity parameter
- *          attributeIndex staarts from index 0, therefore its value cannot be greater than or equal to inputArity
+ * Compares two CSV files of runBenchmarkSuite and prints the measurements of resultsFilename that are more than
+ * tolerance times slower than in baselineFilename (and at least 1 ms slower, to ignore the noise of the smallest
+ * inputs) or have a different number of output tuples, and the measurements of baselineFilename that are missing
+ * from resultsFilename (an operator that stopped running, or a suite run with a smaller maxTupleCount). Returns the
+ * number of such regressions.
  */
-template<size_t arity>
-static relation<arity> selection(relation<arity> inputRelation, int attributeIndex, int operation, int operand) {
-    if (attributeIndex >= arity) {
-        cout << "You are trying to do a selection on an invalid attribute" << endl;
-        exit(1);
-    }
+static int compareBenchmarkResults(const char* baselineFilename, const char* resultsFilename, double tolerance = 1.25) {
+    map<string, suiteResult> baseline;
+    for (const auto& result : loadBenchmarkResults(baselineFilename))
+        baseline[result.operatorName + "," + result.distribution + "," + to_string(result.arity) + "," + to_string(result.tupleCount)] = result;
 
-    auto outputRelation = relation<arity>();
-    set<array<int, arity>> outputDataBuffer;
-    // Iterate through input relation's tuples
-    for (const auto& tuple : inputRelation.getDataBuffer()) {
-        bool condition = false;
-
-        switch (operation) {
-        case EQUAL:
-            condition = (tuple[attributeIndex] == operand);
-            break;
-        case LESSTHAN:
-            condition = (tuple[attributeIndex] < operand);
-            break;
-        case GREATERTHAN:
-            condition = (tuple[attributeIndex] > operand);
-            break;
+    int regressionCount = 0;
+    for (const auto& result : loadBenchmarkResults(resultsFilename)) {
+        auto baselineResult = baseline.find(result.operatorName + "," + result.distribution + "," + to_string(result.arity) + ","
+            + to_string(result.tupleCount));
+        if (baselineResult == baseline.end())
+            continue;
+        const suiteResult before = baselineResult->second;
+        // What is left in baseline at the end is missing from the results
+        baseline.erase(baselineResult);
+        if (result.outputTuples != before.outputTuples) {
+            cout << "OUTPUT MISMATCH " << formatSuiteResult(result) << " (baseline " << before.outputTuples << " tuples)" << endl;
+            ++regressionCount;
         }
-
-        // Add tuple to the output relation if it satisfies the condition
-        if (condition) {
-            outputDataBuffer.insert(tuple);
+        else if (result.milliseconds > before.milliseconds * tolerance && result.milliseconds > before.milliseconds + 1) {
+            cout << "REGRESSION " << formatSuiteResult(result) << " (baseline " << before.milliseconds << " ms, "
+                 << result.milliseconds / before.milliseconds << "x)" << endl;
+            ++regressionCount;
         }
     }
-
-    // Set the tuple count for the output relation
-    outputRelation.setDataBuffer(outputDataBuffer);
-    outputRelation.setTupleCount(outputDataBuffer.size());
-
-    return outputRelation;
+    for (const auto& missing : baseline) {
+        cout << "MISSING " << formatSuiteResult(missing.second) << endl;
+        ++regressionCount;
+    }
+    cout << regressionCount << " regressions" << endl;
+    return regressionCount;
 }
 
-
-
 /*
- * Template parameters:
- *  inputArity - the arity of the input relation
- *  outputArity - the arity of the output relation
- *   
- * Function parameters: 
- *  inputRelation: this is the input relation on which the projection operation will be applied 
- *  indicesOfAttributesToKeepArray: this array will store the indices of the attributes that will be kept
- *                                  the length of the above array is the same as outputArity
- *  
- *  For example:
- *      int indicesOfAttributesToKeepArray[1] = {1};
- *      auto rel1Arity = projection<2, 1>(rel2Arity, indicesOfAttributesToKeepArray) -  
- *                                                  rel2Arity is a 2-arity (i.e. 2 columns) relation, 
- *                                                  on which we are applying the projection operation.
- *                                                  Out of the two columns, we will keep the second column
- *                                                  as specified by te indicesOfAttributesToKeepArray array {1}.
- *                                                  
- * 
- *      int indicesOfAttributesToKeepArray[1] = {0, 2, 4};
- *      auto rel3Arity = projection<5, 3>(rel5Arity, indicesOfAttributesToKeepArray) -
- *                                                  rel5Arity is a 5-arity (i.e. 5 columns) relation, 
- *                                                  on which we are applying the projection operation. 
- *                                                  Out of the five columns, we will keep the first, third and the fifth column
- *                                                  as specified by te indicesOfAttributesToKeepArray array {0, 2, 4}.
- * 
- *  Note:
- *          The arity of the input and outpur relations are not going to be same, therefore the template has only two arity parameter
- *          The number of columns we are going to keep is the same as the arity of the output relation, and therefore the size of the
- *          indicesOfAttributesToKeepArray is outputArity
+ * Maintains selection -> projection -> equi-join views of two 1M-tuple relations through 100 deltas that insert
+ * and delete 1000 tuples of the first relation each, and compares one update with recomputing the views.
  */
-template<size_t inputArity, size_t outputArity>
-static relation<outputArity> projection(relation<inputArity> inputRelation, int* indicesOfAttributesToKeepArray) {
-    if (inputArity < outputArity) {
-        cout << "You are trying to keep more columns than what exists in the relation" << endl;
-        exit(1);
-    }
+static void benchmarkIncrementalViews() {
+    mt19937 generator(42);
+    const int tupleCount = 1000000, deltaCount = 100, deltaTuples = 1000;
+    baseRelation<4> orders(generateRelation<4>(tupleCount, 0, UNIFORM, tupleCount, generator));
+    baseRelation<2> customers(generateRelation<2>(tupleCount, 0, UNIFORM, tupleCount, generator));
+    int projectionColumnIndex[3] = {0, 1, 3};
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {0};
 
-    auto outputRelation = relation<outputArity>();
-    set<array<int, outputArity>> outputDataBuffer;
-    // Iterate through input relation's tuples
-    for (const auto& tuple : inputRelation.getDataBuffer()) {
-        array<int, outputArity> projectedTuple;
+    unique_ptr<selectionView<4>> selected;
+    unique_ptr<projectionView<4, 3>> projected;
+    unique_ptr<equiJoinView<3, 2>> joined;
+    double createTime = measureMilliseconds([&]() {
+        selected.reset(new selectionView<4>(orders, 2, LESSTHAN, 1 << 29));
+        projected.reset(new projectionView<4, 3>(*selected, projectionColumnIndex));
+        joined.reset(new equiJoinView<3, 2>(*projected, customers, 1, joinColumnIndexRelation1, joinColumnIndexRelation2));
+    });
 
-        // Populate projected tuple with specified columns
-        for (size_t i = 0; i < outputArity; ++i) {
-            projectedTuple[i] = tuple[indicesOfAttributesToKeepArray[i]];
+    uniform_int_distribution<int> valueDistribution(0, 1 << 30), keyDistribution(0, tupleCount - 1);
+    double updateTime = 0;
+    for (int delta = 0; delta < deltaCount; ++delta) {
+        vector<array<int, 4>> insertedTuples(deltaTuples), deletedTuples;
+        for (auto& tuple : insertedTuples)
+            tuple = {keyDistribution(generator), valueDistribution(generator), valueDistribution(generator), valueDistribution(generator)};
+        // The deleted tuples are the ones that follow random tuples in the relation
+        for (int i = 0; i < deltaTuples; ++i) {
+            auto tuple = orders.getRelation().getDataBuffer().upper_bound(insertedTuples[i]);
+            if (tuple != orders.getRelation().getDataBuffer().end())
+                deletedTuples.push_back(*tuple);
         }
-        outputDataBuffer.insert(projectedTuple);
-       
-        // Insert the projected tuple into the output relation
-       
+        updateTime += measureMilliseconds([&]() {orders.applyDelta(insertedTuples, deletedTuples);});
     }
 
-    // Set the tuple count for the output relation
-    outputRelation.setDataBuffer(outputDataBuffer);
-    outputRelation.setTupleCount(outputDataBuffer.size());
-
-    return outputRelation;
+    relation<5> recomputed;
+    double recomputeTime = measureMilliseconds([&]() {
+        auto selectionRelation = selection<4>(orders.getRelation(), 2, LESSTHAN, 1 << 29);
+        auto projectionRelation = projection<4, 3>(selectionRelation, projectionColumnIndex);
+        recomputed = equiJoinHash<3, 2>(projectionRelation, customers.getRelation(), 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+    });
+    cout << "views created in " << createTime << " ms; " << deltaCount << " deltas of " << deltaTuples << " inserted and deleted tuples: "
+         << updateTime / deltaCount << " ms per delta, recomputing " << recomputeTime << " ms (speedup "
+         << recomputeTime / (updateTime / deltaCount) << "x); " << joined->getRelation().getTupleCount() << " joined tuples"
+         << (sameTuples(joined->getRelation(), recomputed) ? "" : " (OUTPUT MISMATCH)") << endl;
 }
 
-
 /*
- * 
- * Cross-product (cartesian-product) takes as input two relation, inputRelation1 and inputRelation2
- * Template parameters:
- *  inputArity1 - the arity of the input relation inputRelation1
- *  inputArity2 - the arity of the input relation inputRelation2
- *   
- * Function parameters: 
- *  inputRelation1: the first input relations
- *  inputRelation2: the second input relations
- * 
- *  For example:
- *      auto rel5Arity = crossProduct<2, 3>(rel2Arity, rel3Arity) -  
- *                                                  rel2Arity is a 2-arity (i.e. 2 columns) relation, 
- *                                                  and, rel3Arity is a3-arity (i.e. 3 columns) relation
- *                                                  The output is going to be a 5 arity relation
- *                                                  
- * 
- *  Note:
- *          The arity of the two input relations do not have to be same, therefore the template has two arity parameters for the two input relations
- *          The arity of the output relation can be computed using the arities of the input relations (inputArity1 + inputArity2)
+ * Compares joins of the full inputs with semiJoinReducedJoin (REDUCE_BOTH) on selective joins: 1M x 1M tuples whose
+ * keys do not match at all (like case 2) or match for 1% of the tuples, with equiJoinHash and equiJoinSortMerge, and
+ * 20K x 20K tuples with no match with equiJoinQuadratic. The time and peak memory include the reduction.
  */
-template <size_t inputArity1, size_t inputArity2>
-static relation<inputArity1 + inputArity2> crossProduct(relation<inputArity1> inputRelation1, relation<inputArity2> inputRelation2) {
-    auto outputRelation = relation<inputArity1 + inputArity2>();
-    set<array<int, inputArity1 + inputArity2>> outputDataBuffer;
+static void benchmarkSemiJoinReduction() {
+    const char* filenames[3] = {"benchmarkSemiJoin1", "benchmarkSemiJoinNoMatch", "benchmarkSemiJoinSelective"};
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {0};
+    auto hashJoin = [](const relation<4>& inputRelation1, const relation<4>& inputRelation2, int joinColumnIndexLength,
+        int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray) {
+        return equiJoinHash<4, 4>(inputRelation1, inputRelation2, joinColumnIndexLength, relation1JoinColumnIndexArray, relation2JoinColumnIndexArray);
+    };
+    auto sortMergeJoin = [](const relation<4>& inputRelation1, const relation<4>& inputRelation2, int joinColumnIndexLength,
+        int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray) {
+        return equiJoinSortMerge<4, 4>(inputRelation1, inputRelation2, joinColumnIndexLength, relation1JoinColumnIndexArray, relation2JoinColumnIndexArray);
+    };
+    auto quadraticJoin = [](const relation<4>& inputRelation1, const relation<4>& inputRelation2, int joinColumnIndexLength,
+        int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray) {
+        return equiJoinQuadratic<4, 4>(inputRelation1, inputRelation2, joinColumnIndexLength, relation1JoinColumnIndexArray, relation2JoinColumnIndexArray);
+    };
 
-    for (const auto& tuple1 : inputRelation1.getDataBuffer()) {
-        for (const auto& tuple2 : inputRelation2.getDataBuffer()) {
-            array<int, inputArity1 + inputArity2> combinedTuple;
+    auto compare = [&](const char* name, const relation<4>& inputRelation1, const relation<4>& inputRelation2, auto join) {
+        relation<8> fullOutput, reducedOutput;
+        // An untimed run first, so that the reduced join does not pay for the allocator reclaiming the memory the
+        // previous full join freed
+        semiJoinReducedJoin<4, 4>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2, join);
+        auto reduced = measureAllocations([&]() {
+            reducedOutput = semiJoinReducedJoin<4, 4>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1,
+                joinColumnIndexRelation2, join);
+        });
+        auto full = measureAllocations([&]() {
+            fullOutput = join(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+        });
+        cout << name << ": full inputs " << full.milliseconds << " ms, peak " << full.peakBytes / 1024 << " KB; reduced "
+             << reduced.milliseconds << " ms, peak " << reduced.peakBytes / 1024 << " KB (speedup "
+             << full.milliseconds / reduced.milliseconds << "x); output " << reducedOutput.getTupleCount() << " tuples"
+             << (sameTuples(fullOutput, reducedOutput) ? "" : " (OUTPUT MISMATCH)") << endl;
+    };
 
-            for (size_t i = 0; i < inputArity1; ++i) {
-                combinedTuple[i] = tuple1[i];
-            }
-            for (size_t i = 0; i < inputArity2; ++i) {
-                combinedTuple[inputArity1 + i] = tuple2[i];
-            }
-            outputDataBuffer.insert(combinedTuple);
+    for (int tupleCount : {20000, 1000000}) {
+        generateRelationFile(filenames[0], 4, tupleCount, 0, UNIFORM, 0, tupleCount, 1);
+        generateRelationFile(filenames[1], 4, tupleCount, 0, UNIFORM, tupleCount, tupleCount, 2);
+        generateRelationFile(filenames[2], 4, tupleCount, 0, UNIFORM, tupleCount - tupleCount / 100, tupleCount, 3);
+        relation<4> inputRelation(filenames[0], FLAT_STORAGE), noMatchRelation(filenames[1], FLAT_STORAGE);
+        relation<4> selectiveRelation(filenames[2], FLAT_STORAGE);
+        string size = to_string(tupleCount) + " x " + to_string(tupleCount);
+        if (tupleCount < 1000000) {
+            compare(("equiJoinQuadratic, no match, " + size).c_str(), inputRelation, noMatchRelation, quadraticJoin);
+            continue;
         }
+        compare(("equiJoinHash, no match, " + size).c_str(), inputRelation, noMatchRelation, hashJoin);
+        compare(("equiJoinHash, 1% match, " + size).c_str(), inputRelation, selectiveRelation, hashJoin);
+        compare(("equiJoinSortMerge, no match, " + size).c_str(), inputRelation, noMatchRelation, sortMergeJoin);
+        compare(("equiJoinSortMerge, 1% match, " + size).c_str(), inputRelation, selectiveRelation, sortMergeJoin);
     }
-    outputRelation.setDataBuffer(outputDataBuffer);
-    outputRelation.setTupleCount(outputDataBuffer.size());
-
-    return outputRelation;
+    for (const char* filename : filenames)
+        remove(filename);
 }
 
-
-
 /*
- * 
- * Equi-Join
- * Template parameters:
- *  inputArity1 - the arity of the input relation inputRelation1
- *  inputArity2 - the arity of the input relation inputRelation2
- *   
- * Function parameters: 
- *  inputRelation1: the first input relations
- *  inputRelation2: the second input relations
- *  joinColumnIndexLength - the number of columns on which the join (equality) will be performed
- *  relation1JoinColumnIndexArray - an array that stores the indices of the columns of relation 1 on which join will be performed
- *  relation2JoinColumnIndexArray - an array that stores the indices of the columns of relation 2 on which join will be performed 
- *  
- * 
- *  For example:
- *      int relation1JoinIndex[1] = {0};
- *      int relation2JoinIndex[1] = {1};
- *      auto rel5Arity = equiJoinQuadratic<2, 3>(rel2Arity, rel3Arity, 1, relation1JoinIndex, relation2JoinIndex) -  
- *                                                  rel2Arity is a 2-arity (i.e. 2 columns) relation, 
- *                                                  and, rel3Arity is a3-arity (i.e. 3 columns) relation
- *                                                  The output is going to be a 5 arity relation (rel5Arity).
- *                                                  Equality will be checked on one column. The first column of relations1,
- *                                                  the second column of relation2.
- *                                                  
- * 
- *  Note:
- *          The arity of the two input relations do not have to be same, therefore the template has two arity parameters for the two input relations
- *          The arity of the output relation can be computed using the arities of the input relations (inputArity1 + inputArity2)
+ * Times COUNT and SUM per group on the projection and on the join of a 1M-tuple relation with many duplicates once
+ * projected: on a FLAT_STORAGE relation (the operators sort and deduplicate their output before the group-by), on a
+ * BAG_STORAGE relation, and pipelined with executeGroupBy. Then compares groupBy with parallelGroupBy.
  */
-template <size_t inputArity1, size_t inputArity2>
-static relation<inputArity1 + inputArity2> equiJoinQuadratic(relation<inputArity1> inputRelation1, relation<inputArity2> inputRelation2,
-    int joinColumnIndexLength, int* relation1JoinColumnIndexArray, int* relation2JoinColumnIndexArray) {
-    auto outputRelation = relation<inputArity1 + inputArity2>();
-    set<array<int, inputArity1 + inputArity2>> outputDataBuffer;
+static void benchmarkAggregation() {
+    const int tupleCount = 1000000;
+    mt19937 generator(42);
+    uniform_int_distribution<int> keyDistribution(0, 999), smallValueDistribution(0, 99), valueDistribution(0, 1 << 30);
+    // (key, small value, random, random): the projection on the first two columns has about 100K distinct tuples
+    relationBuilder<4> bagBuilder(BAG_STORAGE);
+    for (int i = 0; i < tupleCount; ++i)
+        bagBuilder.insert({keyDistribution(generator), smallValueDistribution(generator), valueDistribution(generator), valueDistribution(generator)});
+    relation<4> bagRelation = bagBuilder.build();
+    relation<4> flatRelation = bagRelation;
+    flatRelation.setStorageMode(FLAT_STORAGE);
+    // (key, category) for every key
+    relationBuilder<2> categoryBuilder(BAG_STORAGE);
+    for (int key = 0; key < 1000; ++key)
+        categoryBuilder.insert({key, key % 10});
+    relation<2> bagCategories = categoryBuilder.build();
+    relation<2> flatCategories = bagCategories;
+    flatCategories.setStorageMode(FLAT_STORAGE);
 
-    for (const auto& tuple1 : inputRelation1.getDataBuffer()) {
-        for (const auto& tuple2 : inputRelation2.getDataBuffer()) {
-            bool match = true;
+    int projectionColumns[2] = {0, 1};
+    int joinColumns[1] = {0};
+    int keyColumn[1] = {0};
+    int categoryColumn[1] = {5};
+    aggregate projectionAggregates[2] = {{AGGREGATE_COUNT, 0}, {AGGREGATE_SUM, 1}};
+    aggregate joinAggregates[3] = {{AGGREGATE_COUNT, 0}, {AGGREGATE_SUM, 1}, {AGGREGATE_MAX, 2}};
+    // The total of the COUNT column, i.e. the number of tuples that were aggregated
+    auto countedTuples = [](const auto& groups, int countColumn) {
+        long long total = 0;
+        groups.forEachTuple([&](const auto& tuple) {total += tuple[countColumn];});
+        return total;
+    };
 
-            for (int i = 0; i < joinColumnIndexLength; ++i) {
-                if (tuple1[relation1JoinColumnIndexArray[i]] != tuple2[relation2JoinColumnIndexArray[i]]) {
-                    match = false;
-                    break;
-                }
-            }
+    relation<3> flatGroups, bagGroups, pipelinedGroups;
+    double flatTime = measureMilliseconds([&]() {
+        flatGroups = groupBy<2, 1, 2>(projection<4, 2>(flatRelation, projectionColumns), keyColumn, projectionAggregates);
+    });
+    double bagTime = measureMilliseconds([&]() {
+        bagGroups = groupBy<2, 1, 2>(projection<4, 2>(bagRelation, projectionColumns), keyColumn, projectionAggregates);
+    });
+    double pipelinedTime = measureMilliseconds([&]() {
+        pipelinedGroups = executeGroupBy<2, 1, 2>(planProjection<4, 2>(planScan(bagRelation), projectionColumns),
+            keyColumn, projectionAggregates, FLAT_STORAGE);
+    });
+    bagGroups.setStorageMode(FLAT_STORAGE);
+    cout << "projection + groupBy of " << tupleCount << " tuples: FLAT_STORAGE " << flatTime << " ms (" << countedTuples(flatGroups, 1)
+         << " distinct tuples counted), BAG_STORAGE " << bagTime << " ms (" << countedTuples(bagGroups, 1)
+         << " tuples counted), executeGroupBy " << pipelinedTime << " ms"
+         << (pipelinedGroups.getFlatBuffer() == bagGroups.getFlatBuffer() ? "" : " (OUTPUT MISMATCH)") << endl;
 
-            if (match) {
-                array<int, inputArity1 + inputArity2> combinedTuple;
+    relation<4> flatJoinGroups, bagJoinGroups, pipelinedJoinGroups;
+    flatTime = measureMilliseconds([&]() {
+        flatJoinGroups = groupBy<6, 1, 3>(equiJoinHash<4, 2>(flatRelation, flatCategories, 1, joinColumns, joinColumns),
+            categoryColumn, joinAggregates);
+    });
+    bagTime = measureMilliseconds([&]() {
+        bagJoinGroups = groupBy<6, 1, 3>(equiJoinHash<4, 2>(bagRelation, bagCategories, 1, joinColumns, joinColumns),
+            categoryColumn, joinAggregates);
+    });
+    pipelinedTime = measureMilliseconds([&]() {
+        pipelinedJoinGroups = executeGroupBy<6, 1, 3>(planEquiJoin<4, 2>(planScan(bagRelation), planScan(bagCategories), 1,
+            joinColumns, joinColumns), categoryColumn, joinAggregates, FLAT_STORAGE);
+    });
+    bagJoinGroups.setStorageMode(FLAT_STORAGE);
+    cout << "equiJoinHash + groupBy of " << tupleCount << " x 1000 tuples: FLAT_STORAGE " << flatTime << " ms, BAG_STORAGE "
+         << bagTime << " ms, executeGroupBy " << pipelinedTime << " ms ("
+         << countedTuples(pipelinedJoinGroups, 1) << " tuples counted)"
+         << (pipelinedJoinGroups.getFlatBuffer() == bagJoinGroups.getFlatBuffer() ? "" : " (OUTPUT MISMATCH)") << endl;
 
-                for (size_t i = 0; i < inputArity1; ++i) {
-                    combinedTuple[i] = tuple1[i];
-                }
-                for (size_t i = 0; i < inputArity2; ++i) {
-                    combinedTuple[inputArity1 + i] = tuple2[i];
-                }
-                outputDataBuffer.insert(combinedTuple);
-            }
+    // 1M groups of one tuple, and 1000 groups of 1000 tuples
+    for (int groupColumn : {2, 0}) {
+        int groupColumnIndexArray[1] = {groupColumn};
+        aggregate aggregateArray[3] = {{AGGREGATE_COUNT, 0}, {AGGREGATE_MIN, 3}, {AGGREGATE_MAX, 3}};
+        relation<4> serialGroups, parallelGroups;
+        double serialTime = measureMilliseconds([&]() {
+            serialGroups = groupBy<4, 1, 3>(flatRelation, groupColumnIndexArray, aggregateArray);
+        });
+        cout << "groupBy on " << serialGroups.getTupleCount() << " groups: serial " << serialTime << " ms";
+        size_t maxThreadCount = thread::hardware_concurrency() > 4 ? thread::hardware_concurrency() : 4;
+        for (size_t threadCount = 1; threadCount <= maxThreadCount; threadCount *= 2) {
+            threadPool pool(threadCount);
+            double parallelTime = measureMilliseconds([&]() {
+                parallelGroups = parallelGroupBy<4, 1, 3>(flatRelation, groupColumnIndexArray, aggregateArray, pool);
+            });
+            cout << ", " << threadCount << " threads " << parallelTime << " ms (speedup " << serialTime / parallelTime << "x)"
+                 << (parallelGroups.getFlatBuffer() == serialGroups.getFlatBuffer() ? "" : " (OUTPUT MISMATCH)");
         }
+        cout << endl;
     }
-    outputRelation.setDataBuffer(outputDataBuffer);
-    outputRelation.setTupleCount(outputDataBuffer.size());
+}
 
-    return outputRelation;
+/*
+ * Times a selection with one predicate, a conjunction and a disjunction of three predicates on a 1M-tuple
+ * FLAT_STORAGE relation with each selection kernel the CPU supports, and the same conjunction done as three chained
+ * selection calls. The output of every kernel is checked against the scalar kernel.
+ */
+static void benchmarkSelectionKernels() {
+    mt19937 generator(42);
+    auto inputRelation = generateRelation<4>(1000000, 0, UNIFORM, 1000, generator);
+    inputRelation.setStorageMode(FLAT_STORAGE);
+    predicate conjunctionPredicates[3] = {{0, LESSTHAN, 500}, {1, GREATERTHAN, 1 << 28}, {3, LESSTHAN, 1 << 29}};
+    predicate disjunctionPredicates[3] = {{0, EQUAL, 7}, {1, LESSTHAN, 1 << 22}, {3, GREATERTHAN, (1 << 30) - (1 << 22)}};
+    const char* kernelNames[3] = {"scalar", "AVX2", "AVX-512"};
+    int detectedKernel = getSelectionKernel();
+
+    // The scalar outputs are the reference, computing them also brings the input into memory before the timings
+    setSelectionKernel(SCALAR_KERNEL);
+    auto scalarSingleOutput = selection<4>(inputRelation, 0, LESSTHAN, 500);
+    auto scalarConjunctionOutput = selection<4>(inputRelation, conjunctionPredicates, 3, CONJUNCTION);
+    auto scalarDisjunctionOutput = selection<4>(inputRelation, disjunctionPredicates, 3, DISJUNCTION);
+
+    for (int kernel : {SCALAR_KERNEL, AVX2_KERNEL, AVX512_KERNEL}) {
+        if (!setSelectionKernel(kernel))
+            continue;
+        relation<4> singleOutput, conjunctionOutput, disjunctionOutput, chainedOutput;
+        double singleTime = measureMilliseconds([&]() {singleOutput = selection<4>(inputRelation, 0, LESSTHAN, 500);});
+        double conjunctionTime = measureMilliseconds([&]() {
+            conjunctionOutput = selection<4>(inputRelation, conjunctionPredicates, 3, CONJUNCTION);
+        });
+        double disjunctionTime = measureMilliseconds([&]() {
+            disjunctionOutput = selection<4>(inputRelation, disjunctionPredicates, 3, DISJUNCTION);
+        });
+        double chainedTime = measureMilliseconds([&]() {
+            chainedOutput = selection<4>(selection<4>(selection<4>(inputRelation, 0, LESSTHAN, 500), 1, GREATERTHAN, 1 << 28), 3, LESSTHAN, 1 << 29);
+        });
+        bool outputsMatch = sameTuples(singleOutput, scalarSingleOutput) && sameTuples(conjunctionOutput, scalarConjunctionOutput)
+            && sameTuples(disjunctionOutput, scalarDisjunctionOutput) && sameTuples(chainedOutput, scalarConjunctionOutput);
+        cout << kernelNames[kernel] << " kernel: one predicate " << singleTime << " ms (" << singleOutput.getTupleCount()
+             << " tuples), conjunction of three " << conjunctionTime << " ms (" << conjunctionOutput.getTupleCount()
+             << " tuples), disjunction of three " << disjunctionTime << " ms (" << disjunctionOutput.getTupleCount()
+             << " tuples), three chained selections " << chainedTime << " ms" << (outputsMatch ? "" : " (OUTPUT MISMATCH)") << endl;
+    }
+    setSelectionKernel(detectedKernel);
 }
 
+/*
+ * Runs the parallel operators with 1, 2, 4, ... threads (up to the number of hardware threads, and at least 4)
+ * on 1M-tuple FLAT_STORAGE relations, and reports the time and speedup over the serial operator.
+ */
+static void benchmarkParallelScaling() {
+    mt19937 generator(42);
+    const int tupleCount = 1000000;
+    auto inputRelation1 = generateRelation<3>(tupleCount, 0, UNIFORM, tupleCount, generator);
+    auto inputRelation2 = generateRelation<2>(tupleCount, 1, UNIFORM, tupleCount, generator);
+    auto smallRelation = generateRelation<2>(1000, 0, UNIFORM, 1000, generator);
+    inputRelation1.setStorageMode(FLAT_STORAGE);
+    inputRelation2.setStorageMode(FLAT_STORAGE);
+    smallRelation.setStorageMode(FLAT_STORAGE);
+    int joinColumnIndexRelation1[1] = {0};
+    int joinColumnIndexRelation2[1] = {1};
+    int projectionColumnIndex[2] = {2, 1};
+    auto crossProductInput = selection<3>(inputRelation1, 0, LESSTHAN, 2000);
 
+    double serialTimes[4];
+    serialTimes[0] = measureMilliseconds([&]() {selection<3>(inputRelation1, 1, LESSTHAN, 1 << 29);});
+    serialTimes[1] = measureMilliseconds([&]() {projection<3, 2>(inputRelation1, projectionColumnIndex);});
+    serialTimes[2] = measureMilliseconds([&]() {crossProduct<3, 2>(crossProductInput, smallRelation);});
+    serialTimes[3] = measureMilliseconds([&]() {
+        equiJoinHash<3, 2>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2);
+    });
+    const char* operatorNames[4] = {"selection", "projection", "crossProduct", "equiJoinHash"};
+    cout << "serial: ";
+    for (int i = 0; i < 4; ++i)
+        cout << operatorNames[i] << " " << serialTimes[i] << " ms" << (i < 3 ? ", " : "\n");
 
+    size_t maxThreadCount = thread::hardware_concurrency() > 4 ? thread::hardware_concurrency() : 4;
+    for (size_t threadCount = 1; threadCount <= maxThreadCount; threadCount *= 2) {
+        threadPool pool(threadCount);
+        double parallelTimes[4];
+        parallelTimes[0] = measureMilliseconds([&]() {parallelSelection<3>(inputRelation1, 1, LESSTHAN, 1 << 29, pool);});
+        parallelTimes[1] = measureMilliseconds([&]() {parallelProjection<3, 2>(inputRelation1, projectionColumnIndex, pool);});
+        parallelTimes[2] = measureMilliseconds([&]() {parallelCrossProduct<3, 2>(crossProductInput, smallRelation, pool);});
+        parallelTimes[3] = measureMilliseconds([&]() {
+            parallelEquiJoinHash<3, 2>(inputRelation1, inputRelation2, 1, joinColumnIndexRelation1, joinColumnIndexRelation2, pool);
+        });
+        cout << threadCount << " threads: ";
+        for (int i = 0; i < 4; ++i)
+            cout << operatorNames[i] << " " << parallelTimes[i] << " ms (speedup " << serialTimes[i] / parallelTimes[i] << "x)"
+                 << (i < 3 ? ", " : "\n");
+    }
+}
 
 
 
 int main(int argc, char** argv) {
     
+    // --benchmark runs all the benchmarks, --benchmark <name> only one of them
+    if (argc > 1 && string(argv[1]) == "--benchmark") {
+        string benchmarkName = (argc > 2) ? argv[2] : "";
+        if (!allocationsCounted)
+            cout << "Allocations are not counted: compile with RELATIONAL_ALGEBRA_COUNT_ALLOCATIONS defined to count them" << endl;
+        if (benchmarkName.empty() || benchmarkName == "join")
+            benchmarkEquiJoin();
+        if (benchmarkName.empty() || benchmarkName == "storage")
+            benchmarkStorage();
+        if (benchmarkName.empty() || benchmarkName == "parallel")
+            benchmarkParallelScaling();
+        if (benchmarkName.empty() || benchmarkName == "selection")
+            benchmarkSelectionKernels();
+        if (benchmarkName.empty() || benchmarkName == "allocations")
+            benchmarkOperatorAllocations();
+        if (benchmarkName.empty() || benchmarkName == "pipeline")
+            benchmarkPipeline();
+        if (benchmarkName.empty() || benchmarkName == "closure")
+            benchmarkTransitiveClosure();
+        if (benchmarkName.empty() || benchmarkName == "index")
+            benchmarkIndexes();
+        if (benchmarkName.empty() || benchmarkName == "compression")
+            benchmarkCompression();
+        if (benchmarkName.empty() || benchmarkName == "streaming")
+            benchmarkStreaming();
+        if (benchmarkName.empty() || benchmarkName == "dynamic")
+            benchmarkDynamicRelation();
+        if (benchmarkName.empty() || benchmarkName == "joinorder")
+            benchmarkJoinOrder();
+        if (benchmarkName.empty() || benchmarkName == "triangles")
+            benchmarkTriangles();
+        if (benchmarkName.empty() || benchmarkName == "arena")
+            benchmarkArena();
+        if (benchmarkName.empty() || benchmarkName == "profiling")
+            benchmarkProfiling();
+        if (benchmarkName.empty() || benchmarkName == "views")
+            benchmarkIncrementalViews();
+        if (benchmarkName.empty() || benchmarkName == "semijoin")
+            benchmarkSemiJoinReduction();
+        if (benchmarkName.empty() || benchmarkName == "aggregate")
+            benchmarkAggregation();
+        return 0;
+    }
+
+    // --suite [maxTupleCount] [results.csv] [baseline.csv] runs the benchmark suite, and compares it with a previous run
+    if (argc > 1 && string(argv[1]) == "--suite") {
+        long long maxTupleCount = (argc > 2) ? atoll(argv[2]) : 1000000;
+        string resultsFilename = (argc > 3) ? argv[3] : "benchmarkSuite.csv";
+        if (!allocationsCounted)
+            cout << "Allocations are not counted: compile with RELATIONAL_ALGEBRA_COUNT_ALLOCATIONS defined to count them" << endl;
+        runBenchmarkSuite(maxTupleCount, resultsFilename.c_str());
+        if (argc > 4)
+            return compareBenchmarkResults(argv[4], resultsFilename.c_str()) > 0 ? 1 : 0;
+        return 0;
+    }
+
+    // --profile <name> profiles the test cases below and writes the profiles to <name>.json and <name>.trace.json
+    string profileName = (argc > 2 && string(argv[1]) == "--profile") ? argv[2] : "";
+    if (!profileName.empty())
+        enableProfiling(true);
 
     // Please write your own test cases!!!
     // [HERE]
@@ -527,4 +6964,9 @@ int main(int argc, char** argv) {
     case5InputRelation.printRelation();
     projectionRelationA.printRelation();
     projectionRelationA.saveToFile("case5Output");
+
+    if (!profileName.empty()) {
+        exportProfileJson((profileName + ".json").c_str());
+        exportChromeTrace((profileName + ".trace.json").c_str());
+    }
 }